@@ -0,0 +1,288 @@
+/**
+ * Generates synthetic Cog programs that grow along one axis at a time and
+ * measures how long cog takes to compile them and how much memory it uses.
+ *
+ * cog-bench [--update] cog baseline.json
+ *
+ * Every axis is compiled at four sizes. The time is fit against the line
+ * count on a log-log scale, and an axis whose exponent is above
+ * superLinear is flagged, as is one whose lines per second at the largest
+ * size fell more than tolerance below the baseline. With --update the
+ * baseline is rewritten from this run instead.
+ */
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+using namespace std;
+
+static const double superLinear = 1.2;
+static const double tolerance = 0.2;
+static const int repeats = 3;
+static const int scales[] = { 1, 2, 4, 8 };
+
+struct Axis
+{
+	const char *name;
+	int base;
+	string (*generate)(int n);
+};
+
+static string manyFunctions(int n)
+{
+	string src;
+	for (int i = 0; i < n; i++)
+		src += "int32 f" + to_string(i) + "(int32 a)\n{\n\tint32 b = a + " + to_string(i) + ";\n\treturn b;\n}\n\n";
+	src += "void main()\n{\n\tint32 x = 0;\n";
+	for (int i = 0; i < n; i++)
+		src += "\tf" + to_string(i) + "(x);\n";
+	return src + "}\n";
+}
+
+static string manyLocals(int n)
+{
+	string src = "void main()\n{\n\tint32 v0 = 1;\n";
+	for (int i = 1; i < n; i++)
+		src += "\tint32 v" + to_string(i) + " = v" + to_string(i-1) + " + " + to_string(i) + ";\n";
+	return src + "}\n";
+}
+
+static string deepIfElse(int n)
+{
+	string src = "void main()\n{\n\tint32 x = 7;\n\tint32 y = 0;\n\tif (x < 0) {\n\t\ty = 0;\n\t}";
+	for (int i = 1; i < n; i++)
+		src += " else if (x < " + to_string(i) + ") {\n\t\ty = " + to_string(i) + ";\n\t}";
+	return src + " else\n\t\ty = x;\n}\n";
+}
+
+static string longWhile(int n)
+{
+	string src = "void main()\n{\n\tint32 i = 0;\n\tint32 a = 0;\n\tint32 b = 1;\n\twhile (i < 100) {\n";
+	for (int j = 0; j < n; j++)
+		src += j % 2 ? "\t\ta = a + b;\n" : "\t\tb = b ^ a;\n";
+	return src + "\t\ti = i + 1;\n\t}\n}\n";
+}
+
+static string longArguments(int n)
+{
+	string src = "int32 f(";
+	for (int i = 0; i < n; i++)
+		src += string(i ? ", " : "") + "int32 a" + to_string(i);
+	src += ")\n{\n\tint32 s = 0;\n";
+	for (int i = 0; i < n; i++)
+		src += "\ts = s + a" + to_string(i) + ";\n";
+	src += "\treturn s;\n}\n\nvoid main()\n{\n\tint32 x = 1;\n\tf(";
+	for (int i = 0; i < n; i++)
+		src += string(i ? ", " : "") + "x";
+	return src + ");\n}\n";
+}
+
+static string bigAsm(int n)
+{
+	string src = "void main()\n{\n\tint32 value = 1;\n\tasm {\n\t\tmov value, %eax\n";
+	for (int i = 0; i < n; i++)
+		src += i % 2 ? "\t\tadd $" + to_string(i) + ", %eax\n" : "\t\txor %ebx, %eax\n";
+	return src + "\t\tmov %eax, value\n\t}\n}\n";
+}
+
+static string manyOverloads(int n)
+{
+	string src;
+	for (int i = 0; i < n; i++)
+		src += "int32 f(int" + to_string(8 + i) + " a)\n{\n\treturn " + to_string(i) + ";\n}\n\n";
+	src += "void main()\n{\n";
+	for (int i = 0; i < n; i++)
+		src += "\tint" + to_string(8 + i) + " x" + to_string(i) + " = 1;\n\tf(x" + to_string(i) + ");\n";
+	return src + "}\n";
+}
+
+static const Axis axes[] = {
+	{ "functions", 250, manyFunctions },
+	{ "locals", 500, manyLocals },
+	{ "if-else", 250, deepIfElse },
+	{ "while", 500, longWhile },
+	{ "arguments", 100, longArguments },
+	{ "asm", 500, bigAsm },
+	{ "overloads", 50, manyOverloads },
+};
+
+struct Run
+{
+	int lines;
+	double seconds;
+	long rssKB;
+};
+
+/**
+ * Compile filename with cog in a child process, returning the best wall time
+ * and the largest peak RSS of a few runs.
+ */
+static bool measure(const char *cog, const string &filename, Run &run)
+{
+	run.seconds = 1e30;
+	run.rssKB = 0;
+	for (int i = 0; i < repeats; i++) {
+		auto start = chrono::steady_clock::now();
+		pid_t child = fork();
+		if (child == 0) {
+			int null = open("/dev/null", O_WRONLY);
+			dup2(null, 1);
+			dup2(null, 2);
+			execl(cog, cog, "--emit=obj", filename.c_str(), (char*)NULL);
+			_exit(127);
+		}
+
+		int status;
+		struct rusage usage;
+		if (child < 0 || wait4(child, &status, 0, &usage) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+			return false;
+
+		run.seconds = min(run.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+		run.rssKB = max(run.rssKB, usage.ru_maxrss);
+	}
+	return true;
+}
+
+/**
+ * The slope of log(seconds) over log(lines), 1 for linear scaling.
+ */
+static double exponent(const vector<Run> &runs)
+{
+	double n = runs.size(), sx = 0, sy = 0, sxx = 0, sxy = 0;
+	for (auto run = runs.begin(); run != runs.end(); run++) {
+		double x = log((double)run->lines), y = log(run->seconds);
+		sx += x;
+		sy += y;
+		sxx += x*x;
+		sxy += x*y;
+	}
+	return (n*sxy - sx*sy) / (n*sxx - sx*sx);
+}
+
+/**
+ * The baseline is a flat object of "axis": lines per second.
+ */
+static map<string, double> readBaseline(const char *filename)
+{
+	map<string, double> baseline;
+	FILE *file = fopen(filename, "r");
+	if (!file)
+		return baseline;
+
+	char name[256];
+	double value;
+	while (fscanf(file, " %*[{,] \"%255[^\"]\" : %lf", name, &value) == 2)
+		baseline[name] = value;
+	fclose(file);
+	return baseline;
+}
+
+static bool writeBaseline(const char *filename, const map<string, double> &values)
+{
+	FILE *file = fopen(filename, "w");
+	if (!file)
+		return false;
+
+	for (auto value = values.begin(); value != values.end(); value++)
+		fprintf(file, "%s\n\t\"%s\": %.1f", value == values.begin() ? "{" : ",", value->first.c_str(), value->second);
+	fprintf(file, "\n}\n");
+	return fclose(file) == 0;
+}
+
+int main(int argc, char **argv)
+{
+	bool update = argc == 4 && strcmp(argv[1], "--update") == 0;
+	if (argc != 3 && !update) {
+		fprintf(stderr, "usage: %s [--update] cog baseline.json\n", argv[0]);
+		return 1;
+	}
+
+	const char *cog = argv[argc-2];
+	const char *baselineFile = argv[argc-1];
+	map<string, double> baseline = readBaseline(baselineFile);
+	map<string, double> current;
+
+	mkdir("bench/corpus", 0755);
+	printf("%-10s %8s %10s %12s %10s %8s\n", "axis", "size", "lines", "lines/s", "peak KB", "");
+
+	int flagged = 0;
+	for (size_t a = 0; a < sizeof(axes)/sizeof(axes[0]); a++) {
+		const Axis &axis = axes[a];
+		vector<Run> runs;
+		bool failed = false;
+
+		for (size_t s = 0; s < sizeof(scales)/sizeof(scales[0]) && !failed; s++) {
+			int n = axis.base * scales[s];
+			string src = axis.generate(n);
+			string filename = string("bench/corpus/") + axis.name + "_" + to_string(n) + ".cog";
+			FILE *file = fopen(filename.c_str(), "w");
+			if (!file) {
+				fprintf(stderr, "could not write %s\n", filename.c_str());
+				return 1;
+			}
+			fputs(src.c_str(), file);
+			fclose(file);
+
+			Run run;
+			run.lines = count(src.begin(), src.end(), '\n');
+			if (!measure(cog, filename, run)) {
+				printf("%-10s %8d %10d %12s %10s %8s\n", axis.name, n, run.lines, "-", "-", "FAILED");
+				failed = true;
+				break;
+			}
+
+			printf("%-10s %8d %10d %12.0f %10ld\n", axis.name, n, run.lines, run.lines / run.seconds, run.rssKB);
+			runs.push_back(run);
+		}
+
+		if (failed) {
+			++flagged;
+			continue;
+		}
+
+		double k = exponent(runs);
+		double rate = runs.back().lines / runs.back().seconds;
+		current[axis.name] = rate;
+
+		printf("%-10s exponent %.2f", axis.name, k);
+		if (k > superLinear) {
+			printf(", SUPER-LINEAR");
+			++flagged;
+		}
+
+		auto base = baseline.find(axis.name);
+		if (base != baseline.end()) {
+			printf(", %+.1f%% lines/s against the baseline", 100.0 * (rate / base->second - 1.0));
+			if (!update && rate < base->second * (1.0 - tolerance)) {
+				printf(", REGRESSION");
+				++flagged;
+			}
+		} else
+			printf(", no baseline");
+		printf("\n\n");
+	}
+
+	if (update) {
+		if (!writeBaseline(baselineFile, current)) {
+			fprintf(stderr, "could not write %s\n", baselineFile);
+			return 1;
+		}
+		printf("wrote %s\n", baselineFile);
+	}
+
+	if (flagged > 0)
+		printf("%d axes flagged\n", flagged);
+	return flagged > 0 && !update;
+}
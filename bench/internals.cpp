@@ -0,0 +1,230 @@
+/**
+ * Google Benchmark timings of the compiler's hot internal operations, each
+ * at several sizes, so that a change to one of its data structures can come
+ * with numbers from before and after.
+ *
+ * make bench-internals
+ *
+ * writes bench/internals.json, which benchmark's tools/compare.py can diff
+ * against the file from another build.
+ */
+
+#include "Compiler.h"
+#include "Expression.h"
+#include "Lang.h"
+#include "Parser.y.h"
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+using namespace Cog;
+
+// a distinct fixed point type for every i, the same one for the same i
+static Type *createType(Compiler &cog, int i)
+{
+	return new Fixed(cog, i % 2 == 0, 1 + i/2 % 64, i/128);
+}
+
+/**
+ * Hash-consing a type that is already interned, out of state.range(0)
+ * distinct ones, which is what every type the semantic actions build does.
+ */
+static void benchGetType(benchmark::State &state)
+{
+	Compiler cog;
+	int count = state.range(0);
+	for (int i = 0; i < count; i++)
+		cog.getType(createType(cog, i));
+
+	int i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(cog.getType(createType(cog, i)));
+		i = i+1 < count ? i+1 : 0;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchGetType)->RangeMultiplier(8)->Range(8, 4096);
+
+/**
+ * Looking a name up among state.range(0) symbols spread over state.range(1)
+ * nested scopes.
+ */
+static void benchFindSymbol(benchmark::State &state)
+{
+	Compiler cog;
+	cog.loadFile("bench");
+	llvm::Function *function = llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(cog.context), false),
+		llvm::Function::ExternalLinkage, "bench", cog.module);
+	cog.getScope()->setBlock(llvm::BasicBlock::Create(cog.context, "entry", function));
+
+	int count = state.range(0);
+	int depth = state.range(1);
+	int perScope = std::max(1, count/depth);
+	Type *type = cog.getType(createType(cog, 0));
+	std::vector<const char*> keys;
+	for (int i = 0; i < count; i++) {
+		if (i > 0 && i % perScope == 0 && (int)cog.scopes.size() < depth)
+			cog.pushScope();
+		keys.push_back(cog.createSymbol(type, "v" + std::to_string(i))->key);
+	}
+
+	int i = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(cog.findSymbol(keys[i]));
+		i = i+1 < count ? i+1 : 0;
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchFindSymbol)->Ranges({{8, 4096}, {1, 64}});
+
+/**
+ * Entering and leaving a scope that declares one symbol, inside a scope with
+ * state.range(0) symbols. This used to copy the enclosing scope, see
+ * Compiler::findSymbol for how lookup works now.
+ */
+static void benchPushScope(benchmark::State &state)
+{
+	Compiler cog;
+	cog.loadFile("bench");
+	llvm::Function *function = llvm::Function::Create(llvm::FunctionType::get(llvm::Type::getVoidTy(cog.context), false),
+		llvm::Function::ExternalLinkage, "bench", cog.module);
+	cog.getScope()->setBlock(llvm::BasicBlock::Create(cog.context, "entry", function));
+
+	Type *type = cog.getType(createType(cog, 0));
+	for (int i = 0; i < state.range(0); i++)
+		cog.createSymbol(type, "v" + std::to_string(i));
+
+	for (auto _ : state) {
+		cog.pushScope();
+		cog.createSymbol(type, "inner");
+		cog.dropScope();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchPushScope)->RangeMultiplier(8)->Range(8, 4096);
+
+/**
+ * implicitCastDistance over every pair of state.range(0) types, without the
+ * cache in Compiler::getCastDistance, and then through it.
+ */
+static void benchImplicitCastDistance(benchmark::State &state)
+{
+	Compiler cog;
+	std::vector<Type*> types;
+	for (int i = 0; i < state.range(0); i++)
+		types.push_back(cog.getType(createType(cog, i)));
+
+	size_t from = 0, to = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(implicitCastDistance(cog, types[from], types[to]));
+		if (++to == types.size()) {
+			to = 0;
+			from = from+1 < types.size() ? from+1 : 0;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchImplicitCastDistance)->RangeMultiplier(4)->Range(4, 256);
+
+static void benchGetCastDistance(benchmark::State &state)
+{
+	Compiler cog;
+	std::vector<Type*> types;
+	for (int i = 0; i < state.range(0); i++)
+		types.push_back(cog.getType(createType(cog, i)));
+
+	size_t from = 0, to = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(cog.getCastDistance(types[from], types[to]));
+		if (++to == types.size()) {
+			to = 0;
+			from = from+1 < types.size() ? from+1 : 0;
+		}
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchGetCastDistance)->RangeMultiplier(4)->Range(4, 256);
+
+/**
+ * Resolving a call with one argument among state.range(0) overloads that
+ * all accept it, which computes the cast distance to each. The call it
+ * generates is removed again so the block doesn't grow.
+ */
+static void benchCallFunction(benchmark::State &state)
+{
+	Compiler cog;
+	cog.loadFile("bench");
+	llvm::Type *voidType = llvm::Type::getVoidTy(cog.context);
+	llvm::Function *function = llvm::Function::Create(llvm::FunctionType::get(voidType, false),
+		llvm::Function::ExternalLinkage, "bench", cog.module);
+	llvm::BasicBlock *block = llvm::BasicBlock::Create(cog.context, "entry", function);
+	cog.getScope()->setBlock(block);
+	cog.builder.SetInsertPoint(block);
+
+	Type *thisType = cog.getType(new Void(cog));
+	for (int i = 0; i < state.range(0); i++) {
+		Type *argType = cog.getType(new Fixed(cog, true, 16 + i));
+		std::vector<Declaration> args(1, Declaration(argType, "a"));
+		Function *type = (Function*)cog.getType(new Function(thisType, thisType, "f", args));
+		llvm::Function *value = llvm::Function::Create(llvm::FunctionType::get(voidType, { argType->llvmType }, false),
+			llvm::Function::ExternalLinkage, "f" + std::to_string(i), cog.module);
+		cog.declareFunction(type, value);
+	}
+
+	Type *argType = cog.getType(new Fixed(cog, false, 8));
+	char *name = (char*)cog.intern("f");
+	for (auto _ : state) {
+		Info *arg = cog.arena.createInfo();
+		arg->type = argType;
+		arg->value = llvm::ConstantInt::get(argType->llvmType, 1);
+		callFunction(cog, name, arg);
+
+		while (!block->empty())
+			block->back().eraseFromParent();
+		cog.arena.clear();
+	}
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchCallFunction)->RangeMultiplier(4)->Range(1, 256);
+
+/**
+ * APInt_pow(10, state.range(0)), the scale of a decimal constant with that
+ * exponent.
+ */
+static void benchAPIntPow(benchmark::State &state)
+{
+	llvm::APInt base(4, 10);
+	unsigned exp = state.range(0);
+	for (auto _ : state)
+		benchmark::DoNotOptimize(APInt_pow(base, exp));
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(benchAPIntPow)->RangeMultiplier(4)->Range(1, 1024);
+
+/**
+ * Parsing a decimal constant of state.range(0) digits, with a fractional
+ * part when state.range(1) is set, into its value and fixed point type.
+ */
+static void benchGetConstant(benchmark::State &state)
+{
+	Compiler cog;
+	std::string text;
+	for (int i = 0; i < state.range(0); i++)
+		text += (char)('1' + i % 9);
+	if (state.range(1))
+		text.insert(text.size()/2, ".");
+
+	std::vector<char> buffer(text.begin(), text.end());
+	buffer.push_back(0);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(getConstant(cog, DEC_CONSTANT, buffer.data()));
+		cog.arena.clear();
+	}
+	state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(benchGetConstant)->Ranges({{4, 256}, {0, 1}});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,23 @@
+/* Data dependent branches, one Collatz step per iteration. */
+#include <stdint.h>
+
+int main(void)
+{
+	uint32_t x = 27;
+	uint32_t steps = 0;
+	uint32_t i = 0;
+	while (i < ITERATIONS) {
+		if (x == 1) {
+			x = i + 27;
+		} else if ((x & 1) == 0) {
+			x = x >> 1;
+		} else {
+			x = 3*x + 1;
+			steps = steps + 1;
+		}
+		i = i + 1;
+	}
+
+	__asm__ volatile("" :: "r"(steps));
+	return 0;
+}
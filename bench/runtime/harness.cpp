@@ -0,0 +1,152 @@
+/**
+ * Times each kernel in bench/runtime built from Cog and from C.
+ *
+ * cog-runtime-bench cog [kernel...]
+ *
+ * The Cog version is compiled with cog -O2 and linked against shim.c, the C
+ * version is compiled with $CC -O2 (clang by default). Each is built for two
+ * iteration counts so that process startup cancels out of the time per
+ * iteration.
+ */
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+static const long iterations[] = { 10000000, 50000000 };
+static const int repeats = 5;
+static const char *kernels[] = { "mac", "hash", "loop", "branch", "recursion" };
+
+/**
+ * Fork and exec args, with stdout sent to /dev/null, returning the wall time
+ * in seconds or a negative value if it failed.
+ */
+static double run(const vector<string> &args)
+{
+	vector<char*> argv;
+	for (auto arg = args.begin(); arg != args.end(); arg++)
+		argv.push_back((char*)arg->c_str());
+	argv.push_back(NULL);
+
+	auto start = chrono::steady_clock::now();
+	pid_t child = fork();
+	if (child == 0) {
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, 1);
+		execvp(argv[0], argv.data());
+		_exit(127);
+	}
+
+	int status;
+	if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "failed:");
+		for (auto arg = args.begin(); arg != args.end(); arg++)
+			fprintf(stderr, " %s", arg->c_str());
+		fprintf(stderr, "\n");
+		return -1;
+	}
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static double best(const string &program)
+{
+	double result = 1e30;
+	for (int i = 0; i < repeats; i++) {
+		double seconds = run({ program });
+		if (seconds < 0)
+			return -1;
+		result = min(result, seconds);
+	}
+	return result;
+}
+
+/**
+ * Write the Cog source for kernel with ITERATIONS replaced by count.
+ */
+static bool instantiate(const string &kernel, long count, const string &filename)
+{
+	ifstream in("bench/runtime/" + kernel + ".cog");
+	if (!in)
+		return false;
+
+	stringstream buffer;
+	buffer << in.rdbuf();
+	string src = buffer.str();
+
+	string token = "ITERATIONS";
+	for (size_t at = src.find(token); at != string::npos; at = src.find(token, at))
+		src.replace(at, token.size(), to_string(count));
+
+	ofstream out(filename);
+	out << src;
+	return (bool)out;
+}
+
+/**
+ * Build both versions of kernel and return their nanoseconds per iteration.
+ */
+static bool measure(const char *cog, const char *cc, const string &kernel, double &cogNs, double &cNs)
+{
+	double cogTimes[2], cTimes[2];
+	for (int i = 0; i < 2; i++) {
+		string base = "bench/runtime/out/" + kernel + "_" + to_string(iterations[i]);
+		if (!instantiate(kernel, iterations[i], base + ".cog")
+		 || run({ cog, "-O2", "--emit=obj", base + ".cog" }) < 0
+		 || run({ cc, "-O2", base + ".o", "bench/runtime/shim.c", "-o", base + ".cog.out" }) < 0
+		 || run({ cc, "-O2", "-DITERATIONS=" + to_string(iterations[i]), "bench/runtime/" + kernel + ".c", "-o", base + ".c.out" }) < 0)
+			return false;
+
+		cogTimes[i] = best(base + ".cog.out");
+		cTimes[i] = best(base + ".c.out");
+		if (cogTimes[i] < 0 || cTimes[i] < 0)
+			return false;
+	}
+
+	double count = iterations[1] - iterations[0];
+	cogNs = max(cogTimes[1] - cogTimes[0], 0.0) * 1e9 / count;
+	cNs = max(cTimes[1] - cTimes[0], 0.0) * 1e9 / count;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s cog [kernel...]\n", argv[0]);
+		return 1;
+	}
+
+	const char *cog = argv[1];
+	const char *cc = getenv("CC") != NULL ? getenv("CC") : "clang";
+
+	vector<string> selected;
+	for (int i = 2; i < argc; i++)
+		selected.push_back(argv[i]);
+	if (selected.empty())
+		selected.assign(kernels, kernels + sizeof(kernels)/sizeof(kernels[0]));
+
+	mkdir("bench/runtime/out", 0755);
+	printf("%-10s %12s %12s %8s\n", "kernel", "cog ns/op", "C ns/op", "ratio");
+
+	int failed = 0;
+	for (auto kernel = selected.begin(); kernel != selected.end(); kernel++) {
+		double cogNs, cNs;
+		if (!measure(cog, cc, *kernel, cogNs, cNs)) {
+			printf("%-10s %12s %12s %8s\n", kernel->c_str(), "-", "-", "FAILED");
+			++failed;
+			continue;
+		}
+		printf("%-10s %12.3f %12.3f %8.2f\n", kernel->c_str(), cogNs, cNs, cNs > 0 ? cogNs / cNs : 0.0);
+	}
+	return failed > 0;
+}
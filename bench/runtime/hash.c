@@ -0,0 +1,27 @@
+/* FNV style integer hashing mixed with rotates. */
+#include <stdint.h>
+
+static uint32_t rol(uint32_t x, int n)
+{
+	return (x << n) | (x >> (32 - n));
+}
+
+static uint32_t ror(uint32_t x, int n)
+{
+	return (x >> n) | (x << (32 - n));
+}
+
+int main(void)
+{
+	uint32_t h = 2166136261u;
+	uint32_t i = 0;
+	while (i < ITERATIONS) {
+		h = (h ^ i)*16777619u;
+		h = rol(h, 13);
+		h = h ^ ror(h, 7);
+		i = i + 1;
+	}
+
+	__asm__ volatile("" :: "r"(h));
+	return 0;
+}
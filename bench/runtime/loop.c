@@ -0,0 +1,20 @@
+/* Nested counted loops with a carried sum. */
+#include <stdint.h>
+
+int main(void)
+{
+	int32_t sum = 0;
+	int32_t i = 0;
+	while (i < ITERATIONS) {
+		int32_t j = 0;
+		while (j < 16) {
+			sum = sum + i*j;
+			sum = sum ^ (sum >> 3);
+			j = j + 1;
+		}
+		i = i + 1;
+	}
+
+	__asm__ volatile("" :: "r"(sum));
+	return 0;
+}
@@ -0,0 +1,26 @@
+/* Fixed-point multiply-accumulate, a one pole filter over a ramp. */
+#include <stdint.h>
+
+#define Q 16
+#define FIXED(x) ((int32_t)((x) * (1 << Q)))
+
+static int32_t mul(int32_t a, int32_t b)
+{
+	return (int32_t)(((int64_t)a * b) >> Q);
+}
+
+int main(void)
+{
+	int32_t acc = 0;
+	int32_t x = FIXED(0.5);
+	int32_t y = FIXED(1.25);
+	int32_t i = 0;
+	while (i < ITERATIONS) {
+		acc = mul(acc, FIXED(0.75)) + mul(x, y);
+		x = x + FIXED(0.001);
+		i = i + 1;
+	}
+
+	__asm__ volatile("" :: "r"(acc));
+	return 0;
+}
@@ -0,0 +1,23 @@
+/* Call heavy recursion, the call tree of fib(15) and fib(16) alternately,
+   written the same way as recursion.cog. */
+#include <stdint.h>
+
+static void fib(int32_t n)
+{
+	if (n < 2) {
+		__asm__ volatile("" :: "r"(n));
+	} else {
+		fib(n - 1);
+		fib(n - 2);
+	}
+}
+
+int main(void)
+{
+	int32_t i = 0;
+	while (i < ITERATIONS) {
+		fib(15 + (i & 1));
+		i = i + 1;
+	}
+	return 0;
+}
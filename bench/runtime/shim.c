@@ -0,0 +1,8 @@
+/* Cog mangles its symbols, so this provides the C entry point. */
+extern void cogMain(void) __asm__("(void)main");
+
+int main(void)
+{
+	cogMain();
+	return 0;
+}
@@ -0,0 +1,401 @@
+#include "Ast.h"
+#include "Lang.h"
+#include "Compiler.h"
+#include "Parser.y.h"
+
+#include <string.h>
+#include <unordered_set>
+
+namespace Cog
+{
+
+Node::Node(int kind, const char *text, int token, int line)
+{
+	this->kind = kind;
+	this->text = text;
+	this->token = token;
+	this->line = line;
+	first = 0;
+	count = 0;
+	next = -1;
+	last = -1;
+}
+
+Node::~Node()
+{
+}
+
+Ast::Ast()
+{
+	line = 0;
+}
+
+Ast::~Ast()
+{
+}
+
+int Ast::create(int kind, const char *text, int token)
+{
+	nodes.push_back(Node(kind, text, token, line));
+	nodes.back().first = (int)children.size();
+	return (int)nodes.size() - 1;
+}
+
+int Ast::create(int kind, std::initializer_list<int> of, const char *text, int token)
+{
+	int index = create(kind, text, token);
+	children.insert(children.end(), of.begin(), of.end());
+	nodes[index].count = (int)of.size();
+	return index;
+}
+
+/**
+ * Create a node whose children are the elements of list, see append.
+ */
+int Ast::createList(int kind, int list, const char *text, int token)
+{
+	int index = create(kind, text, token);
+	for (int elem = list; elem >= 0; elem = nodes[elem].next) {
+		children.push_back(elem);
+		nodes[index].count++;
+	}
+	return index;
+}
+
+/**
+ * Add elem to the end of the list starting at list, or start one if list is
+ * -1. Returns the start of the list.
+ */
+int Ast::append(int list, int elem)
+{
+	if (elem < 0)
+		return list;
+
+	if (list < 0) {
+		nodes[elem].last = elem;
+		return elem;
+	}
+
+	nodes[nodes[list].last].next = elem;
+	nodes[list].last = elem;
+	return list;
+}
+
+const Node &Ast::get(int index) const
+{
+	return nodes[index];
+}
+
+int Ast::child(const Node &node, int i) const
+{
+	return children[node.first + i];
+}
+
+// the symbol tables of each compiler are keyed by its own interned names
+static char *name(Compiler &cog, const Node &node)
+{
+	return (char*)cog.intern(node.text, (int)strlen(node.text));
+}
+
+static Info *generateExpression(Compiler &cog, const Ast &ast, int index);
+
+static Info *generateType(Compiler &cog, const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	switch (node.kind) {
+	case TYPE_NODE:
+		if (node.token == IDENTIFIER)
+			return getTypename(cog, node.token, name(cog, node));
+		return getTypename(cog, node.token, (char*)node.text);
+	case STATIC_ARRAY_TYPE_NODE:
+		return getStaticArrayTypename(cog, generateType(cog, ast, ast.child(node, 0)), generateExpression(cog, ast, ast.child(node, 1)));
+	case DYNAMIC_ARRAY_TYPE_NODE:
+		return getDynamicArrayTypename(cog, generateType(cog, ast, ast.child(node, 0)));
+	case POINTER_TYPE_NODE:
+		return getPointerTypename(cog, generateType(cog, ast, ast.child(node, 0)));
+	}
+	return NULL;
+}
+
+static Info *generateExpression(Compiler &cog, const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	switch (node.kind) {
+	case CONSTANT_NODE:
+		return getConstant(cog, node.token, (char*)node.text);
+	case IDENTIFIER_NODE:
+		return getIdentifier(cog, name(cog, node));
+	case UNARY_NODE:
+		return unaryOperator(cog, node.token, generateExpression(cog, ast, ast.child(node, 0)));
+	case BINARY_NODE: {
+		Info *left = generateExpression(cog, ast, ast.child(node, 0));
+		Info *right = generateExpression(cog, ast, ast.child(node, 1));
+		return binaryOperator(cog, left, node.token, right);
+	}
+	}
+	return NULL;
+}
+
+/**
+ * Generate each element of the LIST node at index and chain the results the
+ * way the semantic actions expect them.
+ */
+static Info *generateList(Compiler &cog, const Ast &ast, int index, Info *(*generate)(Compiler&, const Ast&, int))
+{
+	const Node &node = ast.get(index);
+	Info *result = NULL;
+	for (int i = 0; i < node.count; i++)
+		result = infoList(cog, result, generate(cog, ast, ast.child(node, i)));
+	return result;
+}
+
+static Info *generateAsmArgument(Compiler &cog, const Ast &ast, int index)
+{
+	if (index < 0)
+		return NULL;
+
+	const Node &node = ast.get(index);
+	switch (node.kind) {
+	case ASM_REGISTER_NODE:
+		return asmRegister(cog, (char*)node.text);
+	case ASM_CONSTANT_NODE:
+		return asmConstant(cog, (char*)node.text);
+	case IDENTIFIER_NODE:
+		return getIdentifier(cog, name(cog, node));
+	case ASM_FUNCTION_NODE:
+		return asmFunction(cog, (char*)node.text, generateList(cog, ast, ast.child(node, 0), generateType));
+	case ASM_ADDRESS_NODE: {
+		Info *base = generateAsmArgument(cog, ast, ast.child(node, 0));
+		Info *offset = generateAsmArgument(cog, ast, ast.child(node, 1));
+		return asmAddress(cog, base, offset, (char*)node.text);
+	}
+	case ASM_MEMORY_NODE: {
+		int segment = ast.child(node, 0);
+		Info *address = generateAsmArgument(cog, ast, ast.child(node, 1));
+		return asmMemoryArg(cog, segment >= 0 ? (char*)ast.get(segment).text : NULL, (char*)node.text, address);
+	}
+	}
+	return NULL;
+}
+
+static Info *generateAsmStatement(Compiler &cog, const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	if (node.kind == ASM_STATEMENT_NODE)
+		return asmStatement(cog, (char*)node.text, generateAsmStatement(cog, ast, ast.child(node, 0)));
+	return asmInstruction(cog, (char*)node.text, generateList(cog, ast, ast.child(node, 0), generateAsmArgument));
+}
+
+static Info *generateName(Compiler &cog, const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	Info *value = node.count > 0 ? generateExpression(cog, ast, ast.child(node, 0)) : NULL;
+	return variableDeclarationName(cog, name(cog, node), value);
+}
+
+static void generateStatement(Compiler &cog, const Ast &ast, int index);
+
+static void generateBlock(Compiler &cog, const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	for (int i = 0; i < node.count; i++)
+		generateStatement(cog, ast, ast.child(node, i));
+}
+
+/**
+ * Call the semantic actions for the statement at index in the same order
+ * that the parser used to reduce it.
+ */
+static void generateStatement(Compiler &cog, const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	cog.line = node.line;
+
+	switch (node.kind) {
+	case BLOCK_NODE:
+		generateBlock(cog, ast, index);
+		break;
+	case DECLARATION_NODE: {
+		Info *type = generateType(cog, ast, ast.child(node, 0));
+		declareSymbols(cog, type, generateList(cog, ast, ast.child(node, 1), generateName));
+		break;
+	}
+	case ASSIGNMENT_NODE: {
+		Info *left = generateExpression(cog, ast, ast.child(node, 0));
+		Info *right = generateExpression(cog, ast, ast.child(node, 1));
+		assignSymbol(cog, left, node.token, right);
+		break;
+	}
+	case ASM_NODE:
+		asmBlock(cog, generateList(cog, ast, ast.child(node, 0), generateAsmStatement));
+		break;
+	case CALL_NODE:
+		callFunction(cog, name(cog, node), generateList(cog, ast, ast.child(node, 0), generateExpression));
+		break;
+	case RETURN_NODE:
+		if (node.count > 0)
+			returnValue(cog, generateExpression(cog, ast, ast.child(node, 0)));
+		else
+			returnVoid(cog);
+		break;
+	case IF_NODE:
+		// condition and body pairs, then the else body if there is one
+		for (int i = 0; i+1 < node.count; i += 2) {
+			if (i > 0)
+				elseifCondition(cog);
+			ifCondition(cog, generateExpression(cog, ast, ast.child(node, i)));
+			generateBlock(cog, ast, ast.child(node, i+1));
+		}
+		if (node.count % 2 == 1) {
+			elseCondition(cog);
+			generateBlock(cog, ast, ast.child(node, node.count-1));
+		}
+		ifStatement(cog);
+		break;
+	case WHILE_NODE:
+		whileKeyword(cog);
+		whileCondition(cog, generateExpression(cog, ast, ast.child(node, 0)));
+		generateBlock(cog, ast, ast.child(node, 1));
+		whileStatement(cog);
+		break;
+	}
+}
+
+/**
+ * Declare the arguments of a PROTOTYPE node in the current scope and return
+ * its return type.
+ */
+static Info *declareArguments(Compiler &cog, const Ast &ast, const Node &proto)
+{
+	Info *retType = generateType(cog, ast, ast.child(proto, 0));
+	const Node &args = ast.get(ast.child(proto, 1));
+	for (int i = 0; i < args.count; i++) {
+		const Node &arg = ast.get(ast.child(args, i));
+		declareSymbol(cog, generateType(cog, ast, ast.child(arg, 0)), name(cog, arg));
+	}
+	return retType;
+}
+
+/**
+ * Declare the STRUCTURE, PROTOTYPE or FUNCTION node at index, returning the
+ * type of the function it declared if it is one.
+ */
+static Type *declareBlock(Compiler &cog, const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	cog.line = node.line;
+
+	Info *info = NULL;
+	if (node.kind == STRUCTURE_NODE) {
+		generateBlock(cog, ast, ast.child(node, 0));
+		structureDefinition(cog, name(cog, node));
+	} else if (node.kind == PROTOTYPE_NODE) {
+		info = functionPrototype(cog, declareArguments(cog, ast, node), name(cog, node));
+	} else if (node.kind == FUNCTION_NODE) {
+		const Node &proto = ast.get(ast.child(node, 0));
+		info = functionPrototype(cog, declareArguments(cog, ast, proto), name(cog, proto));
+	}
+	Type *type = info != NULL ? info->type : NULL;
+	cog.arena.clear();
+	return type;
+}
+
+// adds the names that nodes [first, last) of ast may take from an import
+static void findNames(const Ast &ast, int first, int last, std::vector<const char*> &names, std::unordered_set<std::string> &seen)
+{
+	for (int i = first; i < last; i++) {
+		const Node &node = ast.get(i);
+		if ((node.kind == CALL_NODE || (node.kind == TYPE_NODE && node.token == IDENTIFIER)) && seen.insert(node.text).second)
+			names.push_back(node.text);
+	}
+}
+
+/**
+ * Copy the entries of cog.imports that ast refers to into cog.imported and
+ * declare them, along with the structures the copied signatures use in
+ * turn. Entries nothing refers to are never read from the mapping.
+ */
+static void declareImports(Compiler &cog, const Ast &ast)
+{
+	if (cog.imports.empty())
+		return;
+
+	std::vector<const char*> names;
+	std::unordered_set<std::string> seen;
+	findNames(ast, 0, (int)ast.nodes.size(), names, seen);
+
+	std::vector<int> entries;
+	for (size_t i = 0; i < names.size(); i++) {
+		for (size_t j = 0; j < cog.imports.size(); j++) {
+			std::vector<int> found;
+			cog.imports[j]->lookup(names[i], found);
+			for (size_t k = 0; k < found.size(); k++) {
+				int first = (int)cog.imported.nodes.size();
+				entries.push_back(cog.imports[j]->load(found[k], cog.imported));
+				findNames(cog.imported, first, (int)cog.imported.nodes.size(), names, seen);
+			}
+		}
+	}
+
+	// structures first, since the signatures may use them
+	for (size_t i = 0; i < entries.size(); i++)
+		if (cog.imported.get(entries[i]).kind == STRUCTURE_NODE)
+			declareBlock(cog, cog.imported, entries[i]);
+	for (size_t i = 0; i < entries.size(); i++)
+		if (cog.imported.get(entries[i]).kind != STRUCTURE_NODE)
+			declareBlock(cog, cog.imported, entries[i]);
+}
+
+/**
+ * The declaration pass: declare what the file uses from its imports and
+ * every structure and function signature in the file before any body is
+ * generated, so that a body can call a function defined after it. Adds the
+ * index of each function definition to bodies. Returns false if a function
+ * is defined twice, the bodies then have to be generated in order by one
+ * compiler for the redefinition to be reported.
+ */
+bool declareBlocks(Compiler &cog, const Ast &ast, std::vector<int> &bodies)
+{
+	declareImports(cog, ast);
+
+	std::unordered_set<Type*> defined;
+	bool unique = true;
+	for (int i = 0; i < (int)ast.blocks.size(); i++) {
+		Type *type = declareBlock(cog, ast, ast.blocks[i]);
+		if (ast.get(ast.blocks[i]).kind == FUNCTION_NODE) {
+			if (type != NULL && !defined.insert(type).second)
+				unique = false;
+			bodies.push_back(ast.blocks[i]);
+		}
+	}
+	return unique;
+}
+
+/**
+ * Generate the body of the FUNCTION node at index, whose signature
+ * declareBlocks already declared. Returns the function it defined, or NULL
+ * if its signature couldn't be resolved.
+ */
+llvm::Function *defineFunction(Compiler &cog, const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	const Node &proto = ast.get(ast.child(node, 0));
+	cog.line = node.line;
+
+	functionDeclaration(cog, declareArguments(cog, ast, proto), name(cog, proto));
+	if (cog.currFn == NULL)
+		return NULL;
+	llvm::Function *function = cog.builder.GetInsertBlock()->getParent();
+
+	int body = ast.child(node, 1);
+	if (ast.get(body).kind == ASM_NODE) {
+		generateStatement(cog, ast, body);
+		asmFunctionDefinition(cog);
+	} else {
+		generateBlock(cog, ast, body);
+		functionDefinition(cog);
+	}
+	return function;
+}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Info.h"
+
+#include <vector>
+#include <initializer_list>
+
+namespace Cog
+{
+
+struct Compiler;
+
+// what a Node is, see Parser.y for the children each kind has
+enum NodeKind
+{
+	LIST_NODE,
+	BLOCK_NODE,
+
+	STRUCTURE_NODE,
+	PROTOTYPE_NODE,
+	FUNCTION_NODE,
+	ARGUMENT_NODE,
+	IMPORT_NODE,
+
+	DECLARATION_NODE,
+	NAME_NODE,
+	ASSIGNMENT_NODE,
+	CALL_NODE,
+	RETURN_NODE,
+	IF_NODE,
+	WHILE_NODE,
+
+	CONSTANT_NODE,
+	IDENTIFIER_NODE,
+	UNARY_NODE,
+	BINARY_NODE,
+
+	TYPE_NODE,
+	STATIC_ARRAY_TYPE_NODE,
+	DYNAMIC_ARRAY_TYPE_NODE,
+	POINTER_TYPE_NODE,
+
+	ASM_NODE,
+	ASM_STATEMENT_NODE,
+	ASM_INSTRUCTION_NODE,
+	ASM_REGISTER_NODE,
+	ASM_CONSTANT_NODE,
+	ASM_FUNCTION_NODE,
+	ASM_MEMORY_NODE,
+	ASM_ADDRESS_NODE
+};
+
+/**
+ * One node of the syntax tree. Nodes refer to each other by their index in
+ * Ast::nodes, and the children of a node are the range [first, first+count)
+ * of Ast::children. An optional child that is missing is stored as -1.
+ */
+struct Node
+{
+	Node(int kind, const char *text, int token, int line);
+	~Node();
+
+	// a NodeKind
+	int kind;
+	// the token of a constant or type, or the operator
+	int token;
+	const char *text;
+	int line;
+
+	int first;
+	int count;
+
+	// chains the elements of a list while the parser builds it, see Ast::append
+	int next;
+	int last;
+};
+
+/**
+ * The syntax tree of one file. The parser only builds this, generate walks it
+ * to declare everything and then emits each function body on its own, which
+ * is what lets the bodies be generated on several threads.
+ */
+struct Ast
+{
+	Ast();
+	~Ast();
+
+	std::vector<Node> nodes;
+	std::vector<int> children;
+
+	// the imports, structures, prototypes and functions in source order
+	std::vector<int> blocks;
+
+	// the text of every token but identifiers, which the compiler interns
+	Arena strings;
+
+	// the line of the last token, recorded with each node for error messages
+	int line;
+
+	int create(int kind, const char *text = NULL, int token = 0);
+	int create(int kind, std::initializer_list<int> nodes, const char *text = NULL, int token = 0);
+	int createList(int kind, int list, const char *text = NULL, int token = 0);
+	int append(int list, int elem);
+
+	const Node &get(int index) const;
+	int child(const Node &node, int i) const;
+};
+
+bool declareBlocks(Compiler &cog, const Ast &ast, std::vector<int> &bodies);
+llvm::Function *defineFunction(Compiler &cog, const Ast &ast, int index);
+
+}
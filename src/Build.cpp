@@ -0,0 +1,329 @@
+#include "Build.h"
+#include "Interface.h"
+#include "Cache.h"
+
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/ADT/StringExtras.h>
+
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace Cog
+{
+
+// the first line of a state file, bumped whenever its layout changes
+static const char *stateVersion = "cog-build 1";
+
+/**
+ * One file of a build, with what the last build recorded about it.
+ */
+struct BuildNode
+{
+	BuildNode(const string &path)
+	{
+		this->path = path;
+		mtime = 0;
+		size = 0;
+		waiting = 0;
+		entry = false;
+		stale = false;
+		failed = false;
+	}
+
+	string path;
+	// the stat of the source that hash and imports were recorded for
+	int64_t mtime;
+	int64_t size;
+	// see Interface::getHash
+	string hash;
+	vector<string> imports;
+	// what the object was last built from, empty if it failed
+	string key;
+
+	// filled in while the build runs
+	vector<int> importers;
+	int waiting;
+	bool entry;
+	bool stale;
+	bool failed;
+	string log;
+};
+
+static bool statFile(const string &path, int64_t &mtime, int64_t &size)
+{
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0)
+		return false;
+
+	mtime = (int64_t)info.st_mtim.tv_sec*1000000000 + info.st_mtim.tv_nsec;
+	size = info.st_size;
+	return true;
+}
+
+// the same name Compiler::getOutputName gives the object
+static string getObjectName(const string &path)
+{
+	return path.substr(0, path.find_last_of(".")) + ".o";
+}
+
+/**
+ * Load the nodes a state file recorded, one line per file of the source's
+ * path, mtime, size, hash, key and imports, separated by tabs.
+ */
+static void readState(const string &filename, unordered_map<string, BuildNode> &nodes)
+{
+	ifstream in(filename);
+	string line;
+	if (!getline(in, line) || line != stateVersion)
+		return;
+
+	while (getline(in, line)) {
+		vector<string> fields;
+		size_t start = 0;
+		for (size_t tab = line.find('\t'); tab != string::npos; tab = line.find('\t', start)) {
+			fields.push_back(line.substr(start, tab-start));
+			start = tab+1;
+		}
+		fields.push_back(line.substr(start));
+		if (fields.size() < 5)
+			continue;
+
+		BuildNode node(fields[0]);
+		node.mtime = atoll(fields[1].c_str());
+		node.size = atoll(fields[2].c_str());
+		node.hash = fields[3];
+		node.key = fields[4];
+		node.imports.assign(fields.begin()+5, fields.end());
+		nodes.insert(pair<string, BuildNode>(node.path, node));
+	}
+}
+
+static bool writeState(const string &filename, const vector<BuildNode> &nodes)
+{
+	string temp = getTempName(filename);
+	ofstream out(temp);
+	out << stateVersion << '\n';
+	for (auto node = nodes.begin(); node != nodes.end(); node++) {
+		out << node->path << '\t' << node->mtime << '\t' << node->size << '\t' << node->hash << '\t' << node->key;
+		for (auto path = node->imports.begin(); path != node->imports.end(); path++)
+			out << '\t' << *path;
+		out << '\n';
+	}
+	out.close();
+
+	if (!out || rename(temp.c_str(), filename.c_str()) != 0) {
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Compile every file that roots import, directly or not, that changed since
+ * the last build, along with the roots themselves. A file is recompiled if
+ * its source, the source of a file it imports or the settings changed, or
+ * if its object is gone. Files only start once everything they import is
+ * compiled, which writes the interfaces they import, and up to jobs files
+ * are compiled at once. What each build found is kept in roots[0].build,
+ * and a file whose stat didn't change since is trusted without reading it,
+ * so a build with nothing to do only stats the files.
+ */
+int build(const vector<string> &roots, const Options &options, int jobs, BuildStep step)
+{
+	string stateFile = roots[0] + ".build";
+	unordered_map<string, BuildNode> previous;
+	readState(stateFile, previous);
+
+	// discover the graph breadth first from the roots
+	vector<BuildNode> nodes;
+	unordered_map<string, int> index;
+	for (auto root = roots.begin(); root != roots.end(); root++) {
+		if (index.insert(pair<string, int>(*root, nodes.size())).second)
+			nodes.push_back(BuildNode(*root));
+		nodes[index[*root]].entry = true;
+	}
+
+	bool changed = previous.size() == 0;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		string path = nodes[i].path;
+		int64_t mtime, size;
+		if (!statFile(path, mtime, size)) {
+			fprintf(stderr, "%s: could not read file\n", path.c_str());
+			return 1;
+		}
+
+		auto last = previous.find(path);
+		if (last != previous.end() && last->second.mtime == mtime && last->second.size == size) {
+			nodes[i].hash = last->second.hash;
+			nodes[i].imports = last->second.imports;
+		} else {
+			auto contents = llvm::MemoryBuffer::getFile(path);
+			if (!contents) {
+				fprintf(stderr, "%s: could not read file\n", path.c_str());
+				return 1;
+			}
+			nodes[i].hash = Interface::getHash((*contents)->getBufferStart(), (*contents)->getBufferSize());
+			nodes[i].imports = Interface::findImports(path, (*contents)->getBufferStart(), (*contents)->getBufferSize());
+			changed = true;
+		}
+		nodes[i].mtime = mtime;
+		nodes[i].size = size;
+		if (last != previous.end())
+			nodes[i].key = last->second.key;
+
+		for (auto import = nodes[i].imports.begin(); import != nodes[i].imports.end(); import++)
+			if (index.insert(pair<string, int>(*import, nodes.size())).second)
+				nodes.push_back(BuildNode(*import));
+	}
+	changed = changed || previous.size() != nodes.size();
+
+	// order the files so that each comes after what it imports
+	vector<int> order;
+	vector<int> imports(nodes.size());
+	for (size_t i = 0; i < nodes.size(); i++) {
+		imports[i] = nodes[i].imports.size();
+		for (auto import = nodes[i].imports.begin(); import != nodes[i].imports.end(); import++)
+			nodes[index[*import]].importers.push_back(i);
+		if (imports[i] == 0)
+			order.push_back(i);
+	}
+	for (size_t i = 0; i < order.size(); i++) {
+		vector<int> &importers = nodes[order[i]].importers;
+		for (auto importer = importers.begin(); importer != importers.end(); importer++)
+			if (--imports[*importer] == 0)
+				order.push_back(*importer);
+	}
+	if (order.size() < nodes.size()) {
+		for (size_t i = 0; i < nodes.size(); i++)
+			if (imports[i] > 0) {
+				fprintf(stderr, "%s: import cycle\n", nodes[i].path.c_str());
+				break;
+			}
+		return 1;
+	}
+
+	// the hash of a file and everything it imports, directly or not, built up
+	// in build order from the hashes of its imports
+	vector<string> trees(nodes.size());
+	for (size_t i = 0; i < order.size(); i++) {
+		BuildNode &node = nodes[order[i]];
+		llvm::SHA1 hash;
+		hash.update(node.hash);
+		for (auto import = node.imports.begin(); import != node.imports.end(); import++)
+			hash.update(trees[index[*import]]);
+		trees[order[i]] = llvm::toHex(hash.final(), true);
+	}
+
+	// the roots differ from the other files by their _start
+	Options entryOptions = options, importOptions = options;
+	entryOptions.entry = true;
+	importOptions.entry = false;
+	string entryBase = Compiler(entryOptions).getSettings();
+	string importBase = Compiler(importOptions).getSettings();
+
+	vector<string> keys(nodes.size());
+	int staleCount = 0;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		llvm::SHA1 hash;
+		hash.update(nodes[i].entry ? entryBase : importBase);
+		hash.update(trees[i]);
+		keys[i] = llvm::toHex(hash.final(), true);
+
+		int64_t mtime, size;
+		nodes[i].stale = keys[i] != nodes[i].key || !statFile(getObjectName(nodes[i].path), mtime, size);
+		staleCount += nodes[i].stale;
+	}
+
+	// a stale file waits for the stale files it imports
+	std::mutex lock;
+	std::condition_variable wake;
+	deque<int> ready;
+	int remaining = staleCount;
+	for (size_t i = 0; i < order.size(); i++) {
+		BuildNode &node = nodes[order[i]];
+		if (!node.stale)
+			continue;
+
+		for (auto import = node.imports.begin(); import != node.imports.end(); import++)
+			node.waiting += nodes[index[*import]].stale;
+		if (node.waiting == 0)
+			ready.push_back(order[i]);
+	}
+
+	auto worker = [&]() {
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			wake.wait(guard, [&]() { return !ready.empty() || remaining == 0; });
+			if (ready.empty())
+				return;
+
+			int i = ready.front();
+			ready.pop_front();
+			BuildNode &node = nodes[i];
+			if (!node.failed) {
+				Options nodeOptions = options;
+				nodeOptions.writeInterface = !node.importers.empty();
+				nodeOptions.entry = node.entry;
+				guard.unlock();
+				bool result = step(node.path.c_str(), nodeOptions, node.log);
+				guard.lock();
+				node.failed = !result;
+			} else
+				node.log = node.path + ": skipped, an import failed\n";
+
+			for (auto importer = node.importers.begin(); importer != node.importers.end(); importer++) {
+				BuildNode &next = nodes[*importer];
+				if (!next.stale)
+					continue;
+				next.failed = next.failed || node.failed;
+				if (--next.waiting == 0)
+					ready.push_back(*importer);
+			}
+			--remaining;
+			wake.notify_all();
+		}
+	};
+
+	vector<std::thread> threads;
+	for (int i = 1; i < jobs && i < staleCount; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto thread = threads.begin(); thread != threads.end(); thread++)
+		thread->join();
+
+	// report in build order, which doesn't depend on the scheduling
+	int failed = 0;
+	for (size_t i = 0; i < order.size(); i++) {
+		BuildNode &node = nodes[order[i]];
+		if (!node.stale)
+			continue;
+
+		fputs(node.log.c_str(), stdout);
+		if (node.failed) {
+			fprintf(stderr, "%s: compilation failed\n", node.path.c_str());
+			failed++;
+		}
+		node.key = node.failed ? "" : keys[order[i]];
+	}
+	printf("%d of %d files out of date, %d failed\n", staleCount, (int)nodes.size(), failed);
+
+	int status = failed > 0;
+
+	if ((changed || staleCount > 0) && !writeState(stateFile, nodes)) {
+		fprintf(stderr, "could not write '%s'\n", stateFile.c_str());
+		status = 1;
+	}
+	return status;
+}
+
+}
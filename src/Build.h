@@ -0,0 +1,17 @@
+#pragma once
+
+#include "Compiler.h"
+
+#include <string>
+#include <vector>
+
+namespace Cog
+{
+
+// compiles filename into its object, see compile in main.cpp. Only the roots
+// of a build have options.entry set, which calls main from _start.
+typedef bool (*BuildStep)(const char *filename, const Options &options, std::string &log);
+
+int build(const std::vector<std::string> &roots, const Options &options, int jobs, BuildStep step);
+
+}
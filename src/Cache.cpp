@@ -0,0 +1,322 @@
+#include "Cache.h"
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <cstdio>
+#include <cinttypes>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+
+using namespace std;
+
+namespace Cog
+{
+
+#ifdef COG_VERSION
+const char *compilerVersion = COG_VERSION;
+#else
+const char *compilerVersion = __DATE__ " " __TIME__;
+#endif
+
+/**
+ * Holds an flock on directory/lock for as long as it lives. Every change to
+ * the stats file and every eviction pass is done under the lock.
+ */
+struct CacheLock
+{
+	CacheLock(const string &directory)
+	{
+		fd = open((directory + "/lock").c_str(), O_RDWR | O_CREAT, 0644);
+		if (fd >= 0)
+			flock(fd, LOCK_EX);
+	}
+
+	~CacheLock()
+	{
+		if (fd >= 0) {
+			flock(fd, LOCK_UN);
+			close(fd);
+		}
+	}
+
+	int fd;
+};
+
+/**
+ * A name next to filename that is unique to this thread. It is hidden, so
+ * that eviction doesn't take it for an entry.
+ */
+string getTempName(const string &filename)
+{
+	size_t slash = filename.find_last_of('/');
+	return filename.substr(0, slash+1) + "." + filename.substr(slash+1) + "." + to_string(getpid()) + "." + to_string(hash<thread::id>()(this_thread::get_id()));
+}
+
+/**
+ * Copy from to a temporary file next to to and rename it into place.
+ */
+static bool copyFile(const string &from, const string &to)
+{
+	FILE *in = fopen(from.c_str(), "rb");
+	if (!in)
+		return false;
+
+	string temp = getTempName(to);
+	FILE *out = fopen(temp.c_str(), "wb");
+	if (!out) {
+		fclose(in);
+		return false;
+	}
+
+	char buffer[65536];
+	size_t size;
+	bool result = true;
+	while ((size = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		if (fwrite(buffer, 1, size, out) != size)
+			result = false;
+
+	result = !ferror(in) && result;
+	fclose(in);
+	result = fclose(out) == 0 && result;
+
+	if (!result || rename(temp.c_str(), to.c_str()) != 0) {
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+Cache::Cache(string directory, uint64_t maxSize)
+{
+	this->directory = directory;
+	this->maxSize = maxSize;
+	hits = 0;
+	misses = 0;
+	flushedHits = 0;
+	flushedMisses = 0;
+	stored = 0;
+	mkdir(directory.c_str(), 0755);
+	mkdir((directory + "/objects").c_str(), 0755);
+}
+
+Cache::~Cache()
+{
+	flush();
+}
+
+string Cache::getPath(const string &key)
+{
+	return directory + "/objects/" + key;
+}
+
+/**
+ * Copy the entry for key to filename. Returns false on a miss.
+ */
+bool Cache::fetch(const string &key, const string &filename)
+{
+	string path = getPath(key);
+	bool hit = copyFile(path, filename);
+	if (hit)
+		utime(path.c_str(), NULL);
+
+	countLookup(hit);
+	return hit;
+}
+
+void Cache::store(const string &key, const string &filename)
+{
+	string path = getPath(key);
+	struct stat info;
+	if (copyFile(filename, path) && stat(path.c_str(), &info) == 0)
+		grow(info.st_size);
+}
+
+/**
+ * Like fetch, but into memory.
+ */
+bool Cache::read(const string &key, string &contents)
+{
+	string path = getPath(key);
+	FILE *file = fopen(path.c_str(), "rb");
+	bool hit = file != NULL;
+	if (file) {
+		char buffer[65536];
+		size_t size;
+		contents.clear();
+		while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+			contents.append(buffer, size);
+		hit = !ferror(file);
+		fclose(file);
+	}
+
+	if (hit)
+		utime(path.c_str(), NULL);
+
+	countLookup(hit);
+	return hit;
+}
+
+void Cache::write(const string &key, const string &contents)
+{
+	string path = getPath(key);
+	string temp = getTempName(path);
+	FILE *file = fopen(temp.c_str(), "wb");
+	if (!file)
+		return;
+
+	bool result = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+	result = fclose(file) == 0 && result;
+	if (!result || rename(temp.c_str(), path.c_str()) != 0) {
+		remove(temp.c_str());
+		return;
+	}
+
+	grow(contents.size());
+}
+
+/**
+ * Count size bytes that were just stored. The directory is only scanned for
+ * eviction once they add up to an eighth of maxSize, and otherwise by flush.
+ */
+void Cache::grow(uint64_t size)
+{
+	if ((stored += size) >= maxSize/8)
+		evict();
+}
+
+// a temporary file this old was left behind by a writer that crashed
+static const time_t tempLifetime = 60*60;
+
+/**
+ * Remove the least recently used entries until the directory fits in
+ * maxSize. An entry that is removed while another process is copying it
+ * stays readable through the open file. Temporary files count toward the
+ * size while they may still be written, and are removed once they are
+ * older than tempLifetime.
+ */
+void Cache::evict()
+{
+	stored = 0;
+	CacheLock lock(directory);
+
+	string objects = directory + "/objects";
+	DIR *dir = opendir(objects.c_str());
+	if (!dir)
+		return;
+
+	vector<pair<time_t, pair<off_t, string> > > entries;
+	uint64_t size = 0;
+	time_t now = time(NULL);
+	while (struct dirent *entry = readdir(dir)) {
+		string path = objects + "/" + entry->d_name;
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+			continue;
+
+		if (entry->d_name[0] == '.') {
+			if (now - info.st_mtime > tempLifetime && remove(path.c_str()) == 0)
+				continue;
+			size += info.st_size;
+			continue;
+		}
+
+		entries.push_back(make_pair(info.st_mtime, make_pair(info.st_size, path)));
+		size += info.st_size;
+	}
+	closedir(dir);
+
+	sort(entries.begin(), entries.end());
+	for (auto entry = entries.begin(); entry != entries.end() && size > maxSize; entry++) {
+		if (remove(entry->second.second.c_str()) == 0)
+			size -= entry->second.first;
+	}
+}
+
+void Cache::countLookup(bool hit)
+{
+	if (hit)
+		++hits;
+	else
+		++misses;
+}
+
+/**
+ * Add the lookups since the last flush to the totals in the stats file and
+ * evict if anything was stored since the last pass. The destructor does
+ * this once, which is all a compiler process needs.
+ */
+void Cache::flush()
+{
+	int newHits = hits - flushedHits;
+	int newMisses = misses - flushedMisses;
+	if (stored > 0)
+		evict();
+	if (newHits == 0 && newMisses == 0)
+		return;
+
+	CacheLock lock(directory);
+
+	uint64_t totalHits = 0, totalMisses = 0;
+	string path = directory + "/stats";
+	FILE *file = fopen(path.c_str(), "r");
+	if (file) {
+		if (fscanf(file, "%" SCNu64 " %" SCNu64, &totalHits, &totalMisses) != 2)
+			totalHits = totalMisses = 0;
+		fclose(file);
+	}
+
+	totalHits += newHits;
+	totalMisses += newMisses;
+	flushedHits += newHits;
+	flushedMisses += newMisses;
+
+	file = fopen(path.c_str(), "w");
+	if (file) {
+		fprintf(file, "%" PRIu64 " %" PRIu64 "\n", totalHits, totalMisses);
+		fclose(file);
+	}
+}
+
+/**
+ * The totals of every process that used this directory, this one included,
+ * along with the current number of entries and their size.
+ */
+bool Cache::readStats(uint64_t &totalHits, uint64_t &totalMisses, uint64_t &entries, uint64_t &size)
+{
+	CacheLock lock(directory);
+
+	totalHits = totalMisses = entries = size = 0;
+	FILE *file = fopen((directory + "/stats").c_str(), "r");
+	if (file) {
+		if (fscanf(file, "%" SCNu64 " %" SCNu64, &totalHits, &totalMisses) != 2)
+			totalHits = totalMisses = 0;
+		fclose(file);
+	}
+	totalHits += hits - flushedHits;
+	totalMisses += misses - flushedMisses;
+
+	string objects = directory + "/objects";
+	DIR *dir = opendir(objects.c_str());
+	if (!dir)
+		return false;
+
+	while (struct dirent *entry = readdir(dir)) {
+		struct stat info;
+		if (entry->d_name[0] == '.' || stat((objects + "/" + entry->d_name).c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+			continue;
+
+		++entries;
+		size += info.st_size;
+	}
+	closedir(dir);
+	return true;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+namespace Cog
+{
+
+/**
+ * A content addressed store of compiler outputs, shared between every
+ * compiler process that points at the same directory. Entries are written to
+ * a temporary file and renamed into place, so readers never see a partial
+ * entry. The directory is kept under maxSize by evicting the least recently
+ * used entries, where a hit counts as a use. Eviction and the shared lookup
+ * counts happen in batches, see grow and flush, so a lookup or a store only
+ * touches its own entry.
+ */
+struct Cache
+{
+	Cache(std::string directory, uint64_t maxSize);
+	~Cache();
+
+	std::string directory;
+	uint64_t maxSize;
+
+	// this process only, see readStats for the totals of every process
+	std::atomic<int> hits;
+	std::atomic<int> misses;
+	// how many of those flush already added to the stats file
+	int flushedHits;
+	int flushedMisses;
+	// the bytes stored since the last eviction pass
+	std::atomic<uint64_t> stored;
+
+	bool fetch(const std::string &key, const std::string &filename);
+	void store(const std::string &key, const std::string &filename);
+	bool read(const std::string &key, std::string &contents);
+	void write(const std::string &key, const std::string &contents);
+	void evict();
+	void flush();
+
+	bool readStats(uint64_t &totalHits, uint64_t &totalMisses, uint64_t &entries, uint64_t &size);
+
+	std::string getPath(const std::string &key);
+	void countLookup(bool hit);
+	void grow(uint64_t size);
+};
+
+// identifies the compiler binary in cache keys
+extern const char *compilerVersion;
+
+// a hidden name next to filename that is unique to this thread, for writing
+// a file that is then renamed into place
+std::string getTempName(const std::string &filename);
+
+}
@@ -1,36 +1,133 @@
 #include "Compiler.h"
-#include <llvm/IR/IRPrintingPasses.h>
+#include "Expression.h"
+#include "Parser.y.h"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Linker/Linker.h>
 
-using namespace std;
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <spawn.h>
+#include <sys/wait.h>
 
-extern int line;
-extern int column;
-extern const char *str;
+using namespace std;
 
 namespace Cog
 {
 
-Compiler::Compiler() : builder(context)
+Overload::Overload(Function *type, llvm::Function *value)
+{
+	this->type = type;
+	this->value = value;
+}
+
+Overload::~Overload()
+{
+}
+
+Diagnostic::Diagnostic(int line, int column, size_t offset)
+{
+	this->line = line;
+	this->column = column;
+	this->offset = offset;
+}
+
+Diagnostic::~Diagnostic()
+{
+}
+
+Options::Options()
+{
+	partitions = 1;
+	codegenThreads = 0;
+	irThreads = 1;
+	splitObjects = false;
+	stream = false;
+	optLevel = 0;
+	sizeLevel = 0;
+	outputs = OBJECT_OUTPUT;
+	dumpIR = false;
+	timeTrace = false;
+	writeInterface = false;
+	entry = true;
+	cache = NULL;
+}
+
+Options::~Options()
+{
+}
+
+Compiler::Compiler(const Options &options) : options(options), builder(context)
 {
 	targetTriple = "";
-	scopes.push_back(Scope());
+	cpu = "generic";
+	features = "";
+	target = NULL;
+	module = NULL;
+	scanner = NULL;
+	file = NULL;
+	buffer = NULL;
+	bufferSize = 0;
+	line = 0;
+	column = 0;
+	str = "";
+	typeLookups = 0;
+	typeHits = 0;
+	scopes.emplace_back();
 	currFn = NULL;
+	engine = NULL;
+	trace.enabled = options.timeTrace;
 }
 
 Compiler::~Compiler()
 {
+	delete engine;
 	for (auto type = types.begin(); type != types.end(); type++) {
 		delete *type;
 	}
 	types.clear();
+	typeIndex.clear();
+}
+
+/**
+ * Identifiers are interned once, after which they are compared and hashed by
+ * the address of their characters. The lexer interns every IDENTIFIER token.
+ */
+const char *Compiler::intern(const std::string &name)
+{
+	return identifiers.insert(name).first->c_str();
+}
+
+const char *Compiler::intern(const char *str, int length)
+{
+	return identifiers.insert(std::string(str, length)).first->c_str();
 }
 
 void Compiler::printScope()
 {
-	printf("Scopes:");
-	for (int i = 0; i < (int)scopes.size(); i++)
-		printf(" %d/%d", (int)std::distance(scopes[i].blocks.begin(), scopes[i].curr), (int)scopes[i].blocks.size());
-	printf("\n");
+	log << "Scopes:";
+	for (auto scope = scopes.begin(); scope != scopes.end(); scope++) {
+		int index = 0;
+		for (auto block = scope->blocks.begin(); block != scope->curr; block++)
+			index++;
+		log << " " << index << "/" << scope->blocks.size();
+	}
+	log << endl;
 }
 
 Scope* Compiler::getScope()
@@ -40,28 +137,126 @@ Scope* Compiler::getScope()
 
 void Compiler::pushScope()
 {
-	scopes.push_back(Scope(getScope()));
+	scopes.emplace_back(getScope()->getBlock());
+	scopes.back().depth = (int)scopes.size() - 1;
 }
 
 void Compiler::popScope()
 {
-	scopes[scopes.size()-2].merge(&scopes.back());
+	std::prev(scopes.end(), 2)->merge(&scopes.back());
+	dropScope();
+}
+
+/**
+ * Pop the innermost scope without merging its values into the enclosing one,
+ * unbinding the names it declared.
+ */
+void Compiler::dropScope()
+{
+	Scope *scope = getScope();
+	for (auto symbol = scope->symbols.rbegin(); symbol != scope->symbols.rend(); symbol++) {
+		if (symbol->shadow != NULL)
+			symbols[symbol->key] = symbol->shadow;
+		else
+			symbols.erase(symbol->key);
+	}
 	scopes.pop_back();
 }
 
+void Compiler::resetScope()
+{
+	while (scopes.size() > 0)
+		dropScope();
+	scopes.emplace_back();
+	loops.clear();
+}
+
+Symbol *Compiler::findSymbol(const char *key)
+{
+	auto symbol = symbols.find(key);
+	if (symbol == symbols.end())
+		return NULL;
+
+	return symbol->second;
+}
+
+Symbol *Compiler::createSymbol(Type *type, std::string name)
+{
+	Scope *scope = getScope();
+	scope->symbols.push_back(Symbol(type, name));
+
+	Symbol *symbol = &scope->symbols.back();
+	symbol->key = intern(name);
+	trace.count("symbols");
+	symbol->scope = scope;
+
+	Symbol *&binding = symbols[symbol->key];
+	symbol->shadow = binding;
+	binding = symbol;
+	return symbol;
+}
+
+/**
+ * Hash-cons a type. Every child of newType must already have been returned by
+ * getType so that structurally equal types are also pointer equal, which lets
+ * the hash and eq() of each node look only at the addresses of its children.
+ */
 Type *Compiler::getType(Type *newType)
 {
-	for (auto type = types.begin(); type != types.end(); type++) {
-		if ((*type)->eq(newType)) {
+	++typeLookups;
+	newType->hashValue = newType->hash();
+
+	auto type = typeIndex.find(newType);
+	if (type != typeIndex.end()) {
+		++typeHits;
+		if (*type != newType)
 			delete newType;
-			return *type;
-		}
+		return *type;
 	}
 
+	typeIndex.insert(newType);
 	types.push_back(newType);
 	return newType;
 }
 
+/**
+ * implicitCastDistance only depends on the two interned types, so the result
+ * is computed once per pair.
+ */
+int Compiler::getCastDistance(Type *from, Type *to)
+{
+	if (from == to)
+		return 0;
+
+	std::pair<Type*, Type*> key(from, to);
+	auto dist = castDistances.find(key);
+	if (dist != castDistances.end())
+		return dist->second;
+
+	int result = implicitCastDistance(*this, from, to);
+	castDistances.insert(std::pair<std::pair<Type*, Type*>, int>(key, result));
+	return result;
+}
+
+void Compiler::declareFunction(Function *type, llvm::Function *value)
+{
+	std::vector<Overload> &overloads = functions[intern(type->typeName)];
+	for (int i = 0; i < (int)overloads.size(); i++)
+		if (overloads[i].type == type)
+			return;
+
+	overloads.push_back(Overload(type, value));
+}
+
+std::vector<Overload> *Compiler::getOverloads(const char *key)
+{
+	auto overloads = functions.find(key);
+	if (overloads == functions.end())
+		return NULL;
+
+	return &overloads->second;
+}
+
 void Compiler::loadFile(string filename)
 {
 	
@@ -69,81 +264,781 @@ void Compiler::loadFile(string filename)
 	source = filename;
 }
 
+bool Compiler::parse()
+{
+	if (!parseSyntax())
+		return false;
+
+	if (options.writeInterface) {
+		string hash = Interface::getHash(source);
+		if (hash == "" || !Interface::write(ast, hash, source + ".pifc")) {
+			log << "Could not write interface: " << source << ".pifc" << endl;
+			return false;
+		}
+	}
+	// error() only records what it reports, the compile fails here
+	return loadImports() && generate() && diagnostics.empty();
+}
+
+/**
+ * Only build ast from source.
+ */
+bool Compiler::parseSyntax()
+{
+	if (!openSource(*this, source.c_str()) && !openSource(*this, source.c_str(), false)) {
+		log << "Could not open file: " << source << endl;
+		return false;
+	}
+
+	int result;
+	{
+		TraceScope phase(trace, "Parse", source);
+		result = yyparse(scanner, *this);
+	}
+	closeSource(*this);
+	return result == 0;
+}
+
+/**
+ * Map the interface of every file ast imports into imports. An interface
+ * that is missing or was built from another version of its source is built
+ * again first, which only parses the source.
+ */
+bool Compiler::loadImports()
+{
+	for (int i = 0; i < (int)ast.blocks.size(); i++) {
+		const Node &node = ast.get(ast.blocks[i]);
+		if (node.kind != IMPORT_NODE)
+			continue;
+
+		// the text still has its quotes
+		string path = Interface::resolve(source, string(node.text+1, strlen(node.text)-2));
+		string hash = Interface::getHash(path);
+		if (hash == "") {
+			log << source << ":" << node.line << ": error: could not read import '" << path << "'" << endl;
+			return false;
+		}
+
+		string filename = path + ".pifc";
+		std::shared_ptr<Interface> interface(new Interface());
+		if (!interface->open(filename, hash)) {
+			TraceScope phase(trace, "Interface", path);
+			Options importOptions = options;
+			importOptions.timeTrace = false;
+			importOptions.writeInterface = false;
+			importOptions.cache = NULL;
+
+			Compiler cog(importOptions);
+			cog.loadFile(path);
+			bool parsed = cog.parseSyntax();
+			log << cog.log.str();
+			if (!parsed)
+				return false;
+
+			if (!Interface::write(cog.ast, hash, filename) || !interface->open(filename, hash)) {
+				log << "Could not write interface: " << filename << endl;
+				return false;
+			}
+		}
+		imports.push_back(interface);
+	}
+	return true;
+}
+
+// the instructions generate collects before streamFunctions emits them,
+// large enough that each object has more than a few functions in it
+static const int64_t streamBatch = 1 << 16;
+
+/**
+ * Generate module from ast. Every structure and function signature is
+ * declared first, then the function bodies are generated. With more than
+ * one of options.irThreads each worker generates every n-th body into a
+ * module of its own, since an LLVMContext can't be shared between threads,
+ * and the results are linked into module. Every function is already
+ * declared in module in source order, so the result doesn't depend on the
+ * number of threads. With options.stream the bodies are generated in order
+ * instead and handed to streamFunctions every streamBatch instructions.
+ */
+bool Compiler::generate()
+{
+	TraceScope phase(trace, "Generate", source);
+	vector<int> bodies;
+	bool unique = declareBlocks(*this, ast, bodies);
+
+	// a redefinition is only noticed while the first body is still around
+	if (options.stream && unique && bodies.size() > 0) {
+		if (targetTriple == "" && !setTarget())
+			return false;
+
+		int64_t pending = 0;
+		for (size_t i = 0; i < bodies.size(); i++) {
+			llvm::Function *function = defineFunction(*this, ast, bodies[i]);
+			if (function == NULL)
+				continue;
+			for (auto block = function->begin(); block != function->end(); block++)
+				pending += block->size();
+
+			if (pending >= streamBatch && i+1 < bodies.size()) {
+				if (!streamFunctions())
+					return false;
+				pending = 0;
+			}
+		}
+		return true;
+	}
+
+	int threadCount = std::min(options.irThreads, (int)bodies.size());
+	if (threadCount <= 1 || !unique) {
+		for (size_t i = 0; i < bodies.size(); i++)
+			defineFunction(*this, ast, bodies[i]);
+		return true;
+	}
+
+	vector<llvm::SmallString<0> > bitcode(threadCount);
+	vector<string> logs(threadCount);
+	vector<vector<Diagnostic> > reports(threadCount);
+	auto worker = [&](int index) {
+		Options workerOptions = options;
+		workerOptions.timeTrace = false;
+		workerOptions.writeInterface = false;
+		workerOptions.cache = NULL;
+
+		Compiler cog(workerOptions);
+		cog.loadFile(source);
+		cog.imports = imports;
+		vector<int> ignored;
+		declareBlocks(cog, ast, ignored);
+		// the signatures were reported by this compiler already, only the bodies are new
+		size_t declared = cog.diagnostics.size();
+		size_t start = cog.log.tellp();
+		for (size_t i = index; i < bodies.size(); i += threadCount)
+			defineFunction(cog, ast, bodies[i]);
+
+		llvm::raw_svector_ostream dest(bitcode[index]);
+		llvm::WriteBitcodeToFile(cog.module, dest);
+		logs[index] = cog.log.str().substr(start);
+		reports[index].assign(cog.diagnostics.begin() + declared, cog.diagnostics.end());
+		for (auto report = reports[index].begin(); report != reports[index].end(); report++)
+			report->offset -= start;
+		delete cog.module;
+		cog.module = NULL;
+	};
+
+	vector<std::thread> threads;
+	for (int i = 1; i < threadCount; i++)
+		threads.emplace_back(worker, i);
+	worker(0);
+	for (auto thread = threads.begin(); thread != threads.end(); thread++)
+		thread->join();
+
+	for (int i = 0; i < threadCount; i++) {
+		// a worker's offsets are into its own log, which continues this one
+		size_t start = log.tellp();
+		for (auto report = reports[i].begin(); report != reports[i].end(); report++)
+			diagnostics.push_back(Diagnostic(report->line, report->column, start + report->offset));
+		log << logs[i];
+		auto part = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode[i].str(), source), context);
+		if (!part) {
+			log << "error: " << llvm::toString(part.takeError()) << endl;
+			return false;
+		}
+
+		if (llvm::Linker::linkModules(*module, std::move(*part))) {
+			log << "error: could not link the functions generated by thread " << i << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
 bool Compiler::setTarget(string targetTriple)
 {
 	if (!module) {
-		llvm::errs() << "Module not yet initialized";
+		log << "Module not yet initialized" << endl;
 		return false;
 	} else if (targetTriple != this->targetTriple) {
-		if (this->targetTriple == "") {
-			llvm::InitializeAllTargetInfos();
-			llvm::InitializeAllTargets();
-			llvm::InitializeAllTargetMCs();
-			llvm::InitializeAllAsmParsers();
-			llvm::InitializeAllAsmPrinters();
-		}
+		initializeTargets();
 
 		this->targetTriple = targetTriple;
 		module->setTargetTriple(targetTriple);
 
-		string error;
-		const llvm::Target *targetEntry = llvm::TargetRegistry::lookupTarget(targetTriple, error);
-		if (!targetEntry) {
-			llvm::errs() << "error: " << error;
+		target = createTargetMachine();
+		if (!target)
 			return false;
-		}
-
-		llvm::TargetOptions options;
-		llvm::Optional<llvm::Reloc::Model> relocModel;
-		target = targetEntry->createTargetMachine(targetTriple, "generic", "", options, relocModel);
 
 		module->setDataLayout(target->createDataLayout());
 	}
 	return true;
 }
 
-bool Compiler::emit(llvm::TargetMachine::CodeGenFileType fileType)
+/**
+ * Create a machine for targetTriple. Each code generation thread needs a
+ * machine of its own.
+ */
+llvm::TargetMachine *Compiler::createTargetMachine()
 {
-	if (this->targetTriple == "")
-		setTarget();
+	string error;
+	const llvm::Target *targetEntry = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+	if (!targetEntry) {
+		log << "error: " << error << endl;
+		return NULL;
+	}
 
-	size_t typeindex = source.find_last_of(".");
-	string filename = source.substr(0, typeindex);
-	if (fileType == llvm::TargetMachine::CGFT_AssemblyFile)
-		filename += ".s";
+	llvm::TargetOptions targetOptions;
+	llvm::Optional<llvm::Reloc::Model> relocModel;
+	return targetEntry->createTargetMachine(targetTriple, cpu, features, targetOptions, relocModel, llvm::CodeModel::Default, getCodeGenLevel());
+}
+
+llvm::TargetMachine::CodeGenFileType Compiler::getFileType(int output)
+{
+	if (output == ASSEMBLY_OUTPUT)
+		return llvm::TargetMachine::CGFT_AssemblyFile;
 	else
-		filename += ".o";
+		return llvm::TargetMachine::CGFT_ObjectFile;
+}
 
-  std::error_code EC;
-  llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::F_None);
+llvm::CodeGenOpt::Level Compiler::getCodeGenLevel()
+{
+	if (options.sizeLevel > 0)
+		return llvm::CodeGenOpt::Default;
 
-  if (EC) {
-    llvm::errs() << "Could not open file: " << EC.message();
-    return false;
-  }
+	switch (options.optLevel) {
+	case 0: return llvm::CodeGenOpt::None;
+	case 1: return llvm::CodeGenOpt::Less;
+	case 2: return llvm::CodeGenOpt::Default;
+	default: return llvm::CodeGenOpt::Aggressive;
+	}
+}
 
-  llvm::legacy::PassManager pass;
-	
-	pass.add(llvm::createPrintModulePass(llvm::outs(), "Hello!"));
+/**
+ * Run the function and module pipelines that clang uses for the same
+ * optimization level over the whole module. This happens before the module
+ * is split into partitions so that the inliner sees every function.
+ */
+void Compiler::optimize()
+{
+	if (options.optLevel == 0 && options.sizeLevel == 0)
+		return;
 
-	if (target->addPassesToEmitFile(pass, dest, fileType, llvm::CodeGenOpt::Level::None)) {
-    llvm::errs() << "The target machine can't emit a file of this type";
-    return false;
-  }
+	TraceScope phase(trace, "Optimize");
 
-  pass.run(*module);
-  dest.flush();
+	llvm::PassManagerBuilder builder;
+	builder.OptLevel = options.optLevel;
+	builder.SizeLevel = options.sizeLevel;
+	builder.Inliner = llvm::createFunctionInliningPass(options.optLevel, options.sizeLevel, false);
+	builder.LoopVectorize = options.optLevel > 1 && options.sizeLevel < 2;
+	builder.SLPVectorize = options.optLevel > 1 && options.sizeLevel < 2;
+	builder.DisableUnrollLoops = options.sizeLevel > 0;
+	target->adjustPassManager(builder);
 
-  llvm::outs() << "Wrote " << filename << "\n";
+	llvm::legacy::FunctionPassManager functionPasses(module);
+	functionPasses.add(llvm::createTargetTransformInfoWrapperPass(target->getTargetIRAnalysis()));
+	builder.populateFunctionPassManager(functionPasses);
+
+	llvm::legacy::PassManager modulePasses;
+	modulePasses.add(llvm::createTargetTransformInfoWrapperPass(target->getTargetIRAnalysis()));
+	builder.populateModulePassManager(modulePasses);
+
+	functionPasses.doInitialization();
+	for (auto function = module->begin(); function != module->end(); function++)
+		functionPasses.run(*function);
+	functionPasses.doFinalization();
+
+	modulePasses.run(*module);
+}
 
-  return true;
+/**
+ * Write contents to filename with a single write.
+ */
+static bool writeFile(Compiler &cog, const string &filename, llvm::StringRef contents)
+{
+	std::error_code EC;
+	llvm::raw_fd_ostream dest(filename, EC, llvm::sys::fs::F_None);
+	if (EC) {
+		cog.log << "Could not open file: " << EC.message() << endl;
+		return false;
+	}
+
+	dest.SetUnbuffered();
+	dest << contents;
+	if (dest.has_error()) {
+		cog.log << "Could not write file: " << filename << endl;
+		dest.clear_error();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Link objects into output with "ld -r" ($LD if set) and remove them. The
+ * linker is run directly rather than through a shell, so any file name works.
+ */
+static bool linkObjects(Compiler &cog, const vector<string> &objects, const string &output)
+{
+	const char *linker = getenv("LD");
+	vector<string> args = { linker ? linker : "ld", "-r", "-o", output };
+	args.insert(args.end(), objects.begin(), objects.end());
+
+	vector<char*> argv;
+	for (auto arg = args.begin(); arg != args.end(); arg++)
+		argv.push_back(&(*arg)[0]);
+	argv.push_back(NULL);
+
+	pid_t pid;
+	int status = 0;
+	if (posix_spawnp(&pid, argv[0], NULL, NULL, argv.data(), environ) != 0
+	 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		cog.log << "Could not link objects into " << output << " with " << argv[0] << endl;
+		return false;
+	}
+
+	for (auto filename = objects.begin(); filename != objects.end(); filename++)
+		remove(filename->c_str());
+
+	cog.log << "Wrote " << output << endl;
+	return true;
+}
+
+string Compiler::getExtension(int output)
+{
+	switch (output) {
+	case ASSEMBLY_OUTPUT: return ".s";
+	case BITCODE_OUTPUT: return ".bc";
+	case IR_OUTPUT: return ".ll";
+	default: return ".o";
+	}
+}
+
+string Compiler::getOutputName(int output)
+{
+	size_t typeindex = source.find_last_of(".");
+	return source.substr(0, typeindex) + getExtension(output);
+}
+
+/**
+ * The compiler, target and code generation settings that the output of a
+ * compile depends on, other than its source.
+ */
+string Compiler::getSettings()
+{
+	string triple = targetTriple != "" ? targetTriple : llvm::sys::getDefaultTargetTriple();
+	return string(compilerVersion) + '\0' + triple + '\0' + cpu + '\0' + features + '\0' +
+		to_string(options.partitions) + '\0' + to_string(options.stream) + '\0' + to_string(options.optLevel) + '\0' + to_string(options.sizeLevel) + '\0' +
+		to_string(options.entry) + '\0';
+}
+
+/**
+ * Hash everything the outputs of emit depend on: the compiler, the target,
+ * the code generation settings, the source itself and the files it imports,
+ * directly or not.
+ * Each output is cached under this key followed by its extension. Returns
+ * an empty string if the source can't be read.
+ */
+string Compiler::getCacheKey()
+{
+	auto contents = llvm::MemoryBuffer::getFile(source);
+	if (!contents)
+		return "";
+
+	llvm::SHA1 hash;
+	hash.update(getSettings());
+	hash.update((*contents)->getBuffer());
+
+	// what an import declares is only known once the file is parsed, so
+	// every file that looks imported counts
+	vector<string> paths = Interface::findImports(source, (*contents)->getBufferStart(), (*contents)->getBufferSize());
+	unordered_set<string> seen(paths.begin(), paths.end());
+	for (size_t i = 0; i < paths.size(); i++) {
+		auto imported = llvm::MemoryBuffer::getFile(paths[i]);
+		if (!imported) {
+			hash.update(string(1, '\0'));
+			continue;
+		}
+
+		hash.update(Interface::getHash((*imported)->getBufferStart(), (*imported)->getBufferSize()) + '\0');
+		vector<string> more = Interface::findImports(paths[i], (*imported)->getBufferStart(), (*imported)->getBufferSize());
+		for (auto path = more.begin(); path != more.end(); path++)
+			if (seen.insert(*path).second)
+				paths.push_back(*path);
+	}
+	return llvm::toHex(hash.final(), true);
+}
+
+/**
+ * Write every requested output for source from the cache, in which case
+ * there is nothing left to do. Split objects and IR dumps are never cached.
+ * The interface parse would have written is cached along with them.
+ */
+bool Compiler::fetchCached()
+{
+	if (!options.cache || options.splitObjects || options.dumpIR)
+		return false;
+
+	TraceScope phase(trace, "Cache lookup");
+
+	cacheKey = getCacheKey();
+	if (cacheKey == "")
+		return false;
+
+	vector<string> filenames;
+	if (options.writeInterface) {
+		if (!options.cache->fetch(cacheKey + ".pifc", source + ".pifc"))
+			return false;
+		filenames.push_back(source + ".pifc");
+	}
+
+	for (int output = 1; output <= options.outputs; output <<= 1) {
+		if (!(options.outputs & output))
+			continue;
+
+		string filename = getOutputName(output);
+		if (!options.cache->fetch(cacheKey + getExtension(output), filename))
+			return false;
+		filenames.push_back(filename);
+	}
+
+	for (auto filename = filenames.begin(); filename != filenames.end(); filename++)
+		log << "Wrote " << *filename << " (cached)" << endl;
+	return true;
+}
+
+bool Compiler::emit()
+{
+	// nothing with errors in it is written or cached
+	if (!diagnostics.empty())
+		return false;
+
+	// the backend is only initialized once there is something to emit
+	if (this->targetTriple == "" && !setTarget())
+		return false;
+
+	if (!streamed.empty()) {
+		// whatever is left, such as _start, goes into the last object
+		if (!streamFunctions())
+			return false;
+
+		string filename = getOutputName(OBJECT_OUTPUT);
+		bool written = linkObjects(*this, streamed, filename);
+		if (written && options.cache && cacheKey != "") {
+			options.cache->store(cacheKey + getExtension(OBJECT_OUTPUT), filename);
+			if (options.writeInterface)
+				options.cache->store(cacheKey + ".pifc", source + ".pifc");
+		}
+		return written;
+	}
+
+	optimize();
+
+	if (options.dumpIR) {
+		llvm::raw_os_ostream out(log);
+		module->print(out, NULL);
+	}
+
+	bool result = true;
+	for (int output = 1; output <= options.outputs; output <<= 1) {
+		if (!(options.outputs & output))
+			continue;
+
+		string filename = getOutputName(output);
+		TraceScope phase(trace, "Codegen", filename);
+		bool written;
+		if (options.partitions > 1 && (output == OBJECT_OUTPUT || output == ASSEMBLY_OUTPUT)) {
+			size_t typeindex = filename.find_last_of(".");
+			written = emitPartitions(output, filename.substr(0, typeindex), filename.substr(typeindex));
+		} else
+			written = emitModule(output, filename);
+
+		if (written && options.cache && cacheKey != "")
+			options.cache->store(cacheKey + getExtension(output), filename);
+		result = result && written;
+	}
+
+	// fetchCached writes the interface on a hit, since parse is skipped then
+	if (result && options.writeInterface && options.cache && cacheKey != "")
+		options.cache->store(cacheKey + ".pifc", source + ".pifc");
+	return result;
+}
+
+/**
+ * Emit the whole module as output into memory and write it to filename.
+ */
+bool Compiler::emitModule(int output, string filename)
+{
+	llvm::SmallString<0> buffer;
+	llvm::raw_svector_ostream dest(buffer);
+
+	if (output == BITCODE_OUTPUT)
+		llvm::WriteBitcodeToFile(module, dest);
+	else if (output == IR_OUTPUT)
+		module->print(dest, NULL);
+	else {
+		llvm::legacy::PassManager pass;
+		if (target->addPassesToEmitFile(pass, dest, getFileType(output))) {
+			log << "The target machine can't emit a file of this type" << endl;
+			return false;
+		}
+		pass.run(*module);
+	}
+
+	if (!writeFile(*this, filename, buffer.str()))
+		return false;
+
+	log << "Wrote " << filename << endl;
+	return true;
+}
+
+/**
+ * Run code generation for one partition, which was handed over as bitcode so
+ * that it can be loaded into a context owned by the calling thread. Returns
+ * an error message, or an empty string on success.
+ */
+static string emitPartition(Compiler &cog, const llvm::SmallString<0> &bitcode, llvm::SmallString<0> &object, llvm::TargetMachine::CodeGenFileType fileType)
+{
+	llvm::LLVMContext context;
+	auto module = llvm::parseBitcodeFile(llvm::MemoryBufferRef(bitcode.str(), cog.source), context);
+	if (!module)
+		return llvm::toString(module.takeError());
+
+	std::unique_ptr<llvm::TargetMachine> target(cog.target->getTarget().createTargetMachine(
+		cog.targetTriple, cog.cpu, cog.features, cog.target->Options, llvm::Optional<llvm::Reloc::Model>(),
+		llvm::CodeModel::Default, cog.target->getOptLevel()));
+	(*module)->setDataLayout(target->createDataLayout());
+
+	llvm::raw_svector_ostream dest(object);
+	llvm::legacy::PassManager pass;
+	if (target->addPassesToEmitFile(pass, dest, fileType))
+		return "The target machine can't emit a file of this type";
+
+	pass.run(**module);
+	return "";
+}
+
+/**
+ * Split the module by function into options.partitions modules and generate
+ * code for them on options.codegenThreads threads. Which function goes into
+ * which partition only depends on its name and the partition count, and the
+ * results are written in partition order, so the output does not depend on
+ * the number of threads. Objects are linked back into base.o with "ld -r"
+ * ($LD if set) unless options.splitObjects asks for base.N.o.
+ */
+bool Compiler::emitPartitions(int output, string base, string extension)
+{
+	llvm::TargetMachine::CodeGenFileType fileType = getFileType(output);
+
+	// an LLVMContext can't be shared between threads, so each partition is
+	// serialized here and loaded again by the thread that compiles it
+	vector<llvm::SmallString<0> > bitcode;
+	llvm::SplitModule(llvm::CloneModule(module), options.partitions, [&](std::unique_ptr<llvm::Module> part) {
+		bitcode.emplace_back();
+		llvm::raw_svector_ostream dest(bitcode.back());
+		llvm::WriteBitcodeToFile(part.get(), dest);
+	});
+
+	vector<llvm::SmallString<0> > objects(bitcode.size());
+	vector<string> errors(bitcode.size());
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t i = next++; i < bitcode.size(); i = next++)
+			errors[i] = emitPartition(*this, bitcode[i], objects[i], fileType);
+	};
+
+	int threadCount = options.codegenThreads > 0 ? options.codegenThreads : options.partitions;
+	vector<std::thread> threads;
+	for (int i = 1; i < threadCount && i < (int)bitcode.size(); i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto thread = threads.begin(); thread != threads.end(); thread++)
+		thread->join();
+
+	bool result = true;
+	vector<string> filenames;
+	for (size_t i = 0; i < objects.size(); i++) {
+		if (errors[i] != "") {
+			log << "partition " << i << ": " << errors[i] << endl;
+			result = false;
+			continue;
+		}
+
+		string filename = base + "." + to_string(i) + extension;
+		if (!writeFile(*this, filename, objects[i].str())) {
+			result = false;
+			continue;
+		}
+		filenames.push_back(filename);
+	}
+
+	// there is no sensible way to merge assembly, it is always kept split
+	if (!result || options.splitObjects || output == ASSEMBLY_OUTPUT) {
+		for (auto filename = filenames.begin(); filename != filenames.end(); filename++)
+			log << "Wrote " << *filename << endl;
+		return result;
+	}
+
+	return linkObjects(*this, filenames, base + extension);
+}
+
+/**
+ * Generate code for the function bodies in module, the next streamBatch
+ * instructions or so of the file, and write it to the next base.N.o. The
+ * bodies are deleted again so that only their declarations are left for
+ * the functions that follow to call, which keeps the IR in memory down to
+ * one batch however large the file is.
+ */
+bool Compiler::streamFunctions()
+{
+	optimize();
+
+	if (options.dumpIR) {
+		llvm::raw_os_ostream out(log);
+		module->print(out, NULL);
+	}
+
+	string filename = getOutputName(OBJECT_OUTPUT);
+	size_t typeindex = filename.find_last_of(".");
+	filename = filename.substr(0, typeindex) + "." + to_string(streamed.size()) + filename.substr(typeindex);
+
+	TraceScope phase(trace, "Codegen", filename);
+	llvm::SmallString<0> buffer;
+	llvm::raw_svector_ostream dest(buffer);
+	llvm::legacy::PassManager pass;
+	if (target->addPassesToEmitFile(pass, dest, getFileType(OBJECT_OUTPUT))) {
+		log << "The target machine can't emit a file of this type" << endl;
+		return false;
+	}
+	pass.run(*module);
+
+	if (!writeFile(*this, filename, buffer.str()))
+		return false;
+	streamed.push_back(filename);
+
+	for (auto function = module->begin(); function != module->end(); function++)
+		if (!function->isDeclaration())
+			function->deleteBody();
+	return true;
+}
+
+/**
+ * Hands the object MCJIT generates for the module to the on-disk cache.
+ */
+struct JitCache : llvm::ObjectCache
+{
+	JitCache(Cache *cache, const string &key)
+	{
+		this->cache = cache;
+		this->key = key;
+	}
+
+	Cache *cache;
+	string key;
+
+	void notifyObjectCompiled(const llvm::Module *module, llvm::MemoryBufferRef object) override
+	{
+		cache->write(key, object.getBuffer().str());
+	}
+
+	std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *module) override
+	{
+		return NULL;
+	}
+};
+
+/**
+ * Compile the module into memory with MCJIT and return the address of the
+ * program's main, or NULL on failure. When options.cache is set the object
+ * code is cached under the source's key, and a hit skips parsing and code
+ * generation altogether.
+ */
+void (*Compiler::jit())()
+{
+	string key = options.cache ? getCacheKey() : "";
+	if (key != "")
+		key += ".jit";
+
+	string object;
+	bool cached = key != "" && options.cache->read(key, object);
+	if (!cached && !parse())
+		return NULL;
+
+	if (!setTarget())
+		return NULL;
+	if (!cached)
+		optimize();
+
+	string error;
+	llvm::EngineBuilder builder((std::unique_ptr<llvm::Module>(module)));
+	builder.setEngineKind(llvm::EngineKind::JIT);
+	builder.setErrorStr(&error);
+	builder.setOptLevel(getCodeGenLevel());
+	engine = builder.create();
+	if (!engine) {
+		log << "Could not create execution engine: " << error << endl;
+		return NULL;
+	}
+
+	JitCache jitCache(options.cache, key);
+	if (cached) {
+		std::unique_ptr<llvm::MemoryBuffer> buffer = llvm::MemoryBuffer::getMemBufferCopy(object, source);
+		auto objectFile = llvm::object::ObjectFile::createObjectFile(buffer->getMemBufferRef());
+		if (!objectFile) {
+			log << "Could not load cached object: " << llvm::toString(objectFile.takeError()) << endl;
+			return NULL;
+		}
+		engine->addObjectFile(llvm::object::OwningBinary<llvm::object::ObjectFile>(std::move(*objectFile), std::move(buffer)));
+	} else if (key != "")
+		engine->setObjectCache(&jitCache);
+
+	engine->finalizeObject();
+	engine->setObjectCache(NULL);
+
+	uint64_t address = engine->getFunctionAddress("(void)main");
+	if (!address) {
+		log << "no function 'void main()' to run" << endl;
+		return NULL;
+	}
+	return (void (*)())address;
+}
+
+/**
+ * Record the totals of this compilation and close the trace.
+ */
+void Compiler::finishTrace()
+{
+	if (!trace.enabled)
+		return;
+
+	int64_t instructions = 0;
+	if (module)
+		for (auto function = module->begin(); function != module->end(); function++)
+			for (auto block = function->begin(); block != function->end(); block++)
+				instructions += block->size();
+
+	trace.count("types interned", types.size());
+	trace.count("type lookups", typeLookups);
+	trace.count("type hits", typeHits);
+	trace.count("instructions", instructions);
+	trace.finish();
+}
+
+/**
+ * Only the host backend is linked in, so it is the only one registered.
+ * Other triples fail in createTargetMachine.
+ */
+void initializeTargets()
+{
+	static std::once_flag initialized;
+	std::call_once(initialized, []() {
+		llvm::InitializeNativeTarget();
+		llvm::InitializeNativeTargetAsmPrinter();
+		llvm::InitializeNativeTargetAsmParser();
+	});
 }
 
-std::ostream &error_(const char *dfile, int dline)
+std::ostream &error_(Compiler &cog, const char *dfile, int dline)
 {
-	cout << str << endl;
-	cout << dfile << ":" << dline << " error " << line << ":" << column << ": ";
-	return cout;
+	cog.log << cog.str << endl;
+	cog.log << dfile << ":" << dline << " error " << cog.line << ":" << cog.column << ": ";
+	cog.diagnostics.push_back(Diagnostic(cog.line, cog.column, cog.log.tellp()));
+	return cog.log;
 }
 
 }
@@ -9,6 +9,7 @@
 #include <llvm/Support/Host.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/raw_os_ostream.h>
 #include <llvm/Support/TargetRegistry.h>
 
 #include <llvm/ADT/APFloat.h>
@@ -23,51 +24,217 @@
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/InlineAsm.h>
-#include <llvm/IR/NoFolder.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
 
 #include <llvm/Support/CodeGen.h>
 
 #include <vector>
+#include <list>
+#include <memory>
 #include <string>
 #include <iostream>
+#include <sstream>
+#include <unordered_set>
+#include <unordered_map>
 
 #include "Info.h"
+#include "Cache.h"
+#include "Trace.h"
+#include "Ast.h"
+#include "Interface.h"
 
 namespace Cog
 {
 
+struct Overload
+{
+	Overload(Function *type, llvm::Function *value);
+	~Overload();
+
+	Function *type;
+	llvm::Function *value;
+};
+
+/**
+ * Where a reported error starts, its message runs from offset in the log of
+ * the compiler to the end of that line.
+ */
+struct Diagnostic
+{
+	Diagnostic(int line, int column, size_t offset);
+	~Diagnostic();
+
+	int line;
+	int column;
+	size_t offset;
+};
+
+// the files emit writes, any combination of these
+enum Output
+{
+	OBJECT_OUTPUT = 1,
+	ASSEMBLY_OUTPUT = 2,
+	BITCODE_OUTPUT = 4,
+	IR_OUTPUT = 8
+};
+
+/**
+ * Settings that come from the command line rather than the source.
+ */
+struct Options
+{
+	Options();
+	~Options();
+
+	// number of modules the program is split into for code generation, the
+	// output only depends on this and not on codegenThreads
+	int partitions;
+	int codegenThreads;
+	// threads generating the IR of function bodies, each with its own
+	// context, their modules are linked into the main one
+	int irThreads;
+	// keep one object per partition instead of linking them into one
+	bool splitObjects;
+	// generate code for the function bodies while the file is generated and
+	// free their IR, see Compiler::streamFunctions
+	bool stream;
+	// -O0 to -O3, -Os sets sizeLevel 1 and -Oz sizeLevel 2 on top of -O2
+	int optLevel;
+	int sizeLevel;
+	// a mask of Output
+	int outputs;
+	// print the optimized module to the log
+	bool dumpIR;
+	// record Compiler::trace
+	bool timeTrace;
+	// also write the precompiled interface of the source, for the files
+	// that import it
+	bool writeInterface;
+	// give the program a _start that calls main, only the roots of a build
+	// leave this set
+	bool entry;
+	// shared by every compiler in the process, NULL when caching is off
+	Cache *cache;
+};
+
 struct Compiler
 {
-	Compiler();
+	Compiler(const Options &options = Options());
 	~Compiler();
 
+	Options options;
 	llvm::LLVMContext context;
-	llvm::IRBuilder<llvm::NoFolder> builder;
+	llvm::IRBuilder<> builder;
 	std::string targetTriple;
+	std::string cpu;
+	std::string features;
 	llvm::TargetMachine *target;
 	llvm::Module *module;
 	std::string source;
+	// set by fetchCached on a miss, emit stores its output under it
+	std::string cacheKey;
+	// the objects streamFunctions wrote so far, emit links them into one
+	std::vector<std::string> streamed;
+
+	// lexer state, see Lexer.l
+	void *scanner;
+	FILE *file;
+	char *buffer;
+	size_t bufferSize;
+	int line;
+	int column;
+	const char *str;
+
+	// the parser builds ast, generate turns it into module
+	Ast ast;
+	Arena arena;
+
+	// the interfaces of the files ast imports, shared with the workers of
+	// generate, and the entries of them that ast refers to
+	std::vector<std::shared_ptr<Interface> > imports;
+	Ast imported;
+
+	// everything this compilation reports, so that concurrent compilations
+	// can be printed in a deterministic order
+	std::stringstream log;
+	std::vector<Diagnostic> diagnostics;
+	Trace trace;
 
 	std::list<Type*> types;
-	std::vector<Scope> scopes;
+	std::unordered_set<Type*, TypeHash, TypeEqual> typeIndex;
+	int typeLookups;
+	int typeHits;
+
+	// every declared function by name, filled in as functions are declared
+	std::unordered_map<const char*, std::vector<Overload> > functions;
+	std::unordered_map<std::pair<Type*, Type*>, int, TypePairHash> castDistances;
+
+	std::unordered_set<std::string> identifiers;
+	std::unordered_map<const char*, Symbol*> symbols;
+	std::list<Scope> scopes;
+	// the while loops being generated, innermost last
+	std::vector<Loop> loops;
 
 	Function *currFn;
 
+	const char *intern(const std::string &name);
+	const char *intern(const char *str, int length);
+
 	void printScope();
 	Scope* getScope();
 	void pushScope();
 	void popScope();
+	void dropScope();
+	void resetScope();
+
+	Symbol *findSymbol(const char *key);
+	Symbol *createSymbol(Type *type, std::string name);
 
 	Type *getType(Type *newType);
+	int getCastDistance(Type *from, Type *to);
+
+	void declareFunction(Function *type, llvm::Function *value);
+	std::vector<Overload> *getOverloads(const char *key);
 
 	void loadFile(std::string filename);
+	bool parse();
+	bool parseSyntax();
+	bool loadImports();
+	bool generate();
 	bool setTarget(std::string targetTriple = llvm::sys::getDefaultTargetTriple());	
+	llvm::TargetMachine *createTargetMachine();
+	llvm::TargetMachine::CodeGenFileType getFileType(int output);
+	llvm::CodeGenOpt::Level getCodeGenLevel();
+	void optimize();
 	
-	bool emit(llvm::TargetMachine::CodeGenFileType fileType = llvm::TargetMachine::CGFT_ObjectFile);
+	std::string getExtension(int output);
+	std::string getOutputName(int output);
+	std::string getSettings();
+	std::string getCacheKey();
+	bool fetchCached();
+	bool emit();
+	bool emitModule(int output, std::string filename);
+	bool emitPartitions(int output, std::string base, std::string extension);
+	bool streamFunctions();
+
+	// owns module once jit has been called
+	llvm::ExecutionEngine *engine;
+	void (*jit())();
+
+	void finishTrace();
 };
 
 
-std::ostream &error_(const char *dfile, int dline);
-#define error() error_(__FILE__, __LINE__)
+// registers the host backend, safe to call from any thread and more than once
+void initializeTargets();
+
+// implemented in Lexer.l
+bool openSource(Compiler &cog, const char *filename, bool mapped = true);
+bool openText(Compiler &cog, const char *text, size_t length);
+void closeSource(Compiler &cog);
+
+// expects a Compiler named cog in scope
+std::ostream &error_(Compiler &cog, const char *dfile, int dline);
+#define error() error_(cog, __FILE__, __LINE__)
 
 }
@@ -3,14 +3,12 @@
 #include "Parser.y.h"
 #include "Intrinsic.h"
 
-extern Cog::Compiler cog;
-
 using std::endl;
 
 namespace Cog
 {
 
-llvm::Value *castType(llvm::Value* value, Typename from, Typename to)
+llvm::Value *castType(Compiler &cog, llvm::Value* value, Typename from, Typename to)
 {
 	llvm::Type *ft = from.getLlvm();
 	llvm::Type *tt = to.getLlvm();
@@ -69,7 +67,7 @@ llvm::Value *castType(llvm::Value* value, Typename from, Typename to)
 		} else if (ft->isIntegerTy() && tt->isIntegerTy()) {
 			if (fp->kind != PrimType::Boolean && tp->kind != PrimType::Boolean) {
 				if (fp->kind == PrimType::Signed && tp->kind == PrimType::Unsigned) {
-					value = fn_abs(value);
+					value = fn_abs(cog, value);
 					fp->kind = PrimType::Unsigned;
 				}
 
@@ -89,7 +87,7 @@ llvm::Value *castType(llvm::Value* value, Typename from, Typename to)
 					if (fp->kind == PrimType::Unsigned)
 						value = cog.builder.CreateLShr(value, tp->exponent - fp->exponent);	
 					else
-						value = fn_div2(value, tp->exponent - fp->exponent);
+						value = fn_div2(cog, value, tp->exponent - fp->exponent);
 				}
 				fp->exponent = tp->exponent;
 
@@ -108,16 +106,20 @@ llvm::Value *castType(llvm::Value* value, Typename from, Typename to)
 	return value;
 }
 
-Info *castType(Info *from, const Typename &to)
+Info *castType(Compiler &cog, Info *from, const Typename &to)
 {
-	from->value = castType(from->value, from->type, to);
+	if (from->isLiteral)
+		from->value = from->literal.materialize(to);
+	else
+		from->value = castType(cog, from->value, from->type, to);
+	from->isLiteral = false;
 	from->symbol = NULL;
 	from->type = to;
 
 	return from;
 }
 
-int implicitCastDistance(const Typename &from, const Typename &to)
+int implicitCastDistance(Compiler &cog, const Typename &from, const Typename &to)
 {
 	// This is a measure of the number of precision bits lost
 	if (from.prim && to.prim) {
@@ -216,7 +218,7 @@ int implicitCastDistance(const Typename &from, const Typename &to)
 		int tempDist = 0;
 
 		for (int i = 0; i < (int)fb->args.size(); i++) {
-			tempDist = implicitCastDistance(fb->args[i].type, tb->args[i].type);
+			tempDist = implicitCastDistance(cog, fb->args[i].type, tb->args[i].type);
 			if (tempDist < 0)
 				return -1;
 			else
@@ -230,7 +232,7 @@ int implicitCastDistance(const Typename &from, const Typename &to)
 	}
 }
 
-void unaryTypecheck(Info *arg, const Typename &expect)
+void unaryTypecheck(Compiler &cog, Info *arg, const Typename &expect)
 {
 	llvm::Type *at = arg->type.getLlvm();
 
@@ -245,14 +247,14 @@ void unaryTypecheck(Info *arg, const Typename &expect)
 	 || at->isVectorTy())) {
 		error() << "type promotion '" << arg->type.getName() << "' to '" << expect.getName() << "' not yet supported." << endl;
 	} else {
-		if (implicitCastDistance(arg->type, expect) >= 0)
-			castType(arg, expect);
+		if (implicitCastDistance(cog, arg->type, expect) >= 0)
+			castType(cog, arg, expect);
 		else if (arg->type != expect)
 			error() << "unable to cast '" << arg->type.getName() << "' to '" << expect.getName() << "'." << endl;
 	}
 }
 
-void binaryTypecheck(Info *left, Info *right)
+void binaryTypecheck(Compiler &cog, Info *left, Info *right)
 {
 	llvm::Type *lt = left->type.getLlvm();
 	llvm::Type *rt = right->type.getLlvm();
@@ -271,55 +273,160 @@ void binaryTypecheck(Info *left, Info *right)
 	 || lt->isVectorTy()		|| rt->isVectorTy())) {
 		error() << "type promotion '" << left->type.getName() << "', '" << right->type.getName() << "' not yet supported." << endl;
 	} else {
-		int ltor = implicitCastDistance(left->type, right->type);
-		int rtol = implicitCastDistance(right->type, left->type);
+		int ltor = implicitCastDistance(cog, left->type, right->type);
+		int rtol = implicitCastDistance(cog, right->type, left->type);
 
 		if (ltor >= 0 && (rtol < 0 || ltor <= rtol))
-			castType(left, right->type);
+			castType(cog, left, right->type);
 		else if (rtol >= 0 && (ltor < 0 || rtol <= ltor))
-			castType(right, left->type);
+			castType(cog, right, left->type);
 
 		if (left->type != right->type)
 			error() << "type mismatch '" << left->type.getName() << "' != '" << right->type.getName() << "'." << endl;
 	}
 }
 
-Info *getBooleanOr(Info *left, Info *right)
+static void setLiteral(Compiler &cog, Info *info, const Literal &literal)
+{
+	info->literal = literal;
+	info->type = literal.getType(cog);
+	info->value = literal.materialize(info->type);
+	info->symbol = NULL;
+}
+
+static void setLiteral(Compiler &cog, Info *info, bool value)
+{
+	info->literal = Literal(llvm::APInt(1, value), 0, false);
+	info->type = cog.getType(new Boolean(cog));
+	info->value = info->literal.materialize(info->type);
+	info->symbol = NULL;
+}
+
+/**
+ * Evaluate op on a literal exactly. Returns false when the operator has no
+ * exact meaning for arg, which is then left to the code generated for it.
+ */
+bool foldUnaryOperator(Compiler &cog, int op, Info *arg)
+{
+	if (!arg->isLiteral)
+		return false;
+
+	switch (op) {
+	case '-':
+		setLiteral(cog, arg, arg->literal.neg());
+		return true;
+	case '~':
+		if (!arg->literal.isInteger())
+			return false;
+		setLiteral(cog, arg, arg->literal.bitwiseNot());
+		return true;
+	case NOT:
+		setLiteral(cog, arg, arg->literal.isZero());
+		return true;
+	}
+	return false;
+}
+
+/**
+ * Evaluate left op right exactly when both are literals, leaving the result in
+ * left. Returns false when the operator has no exact meaning for the operands,
+ * rotates for example depend on the width of a type, in which case the
+ * operands are left untouched.
+ */
+bool foldBinaryOperator(Compiler &cog, Info *left, int op, Info *right)
+{
+	if (!left->isLiteral || !right->isLiteral)
+		return false;
+
+	const Literal &l = left->literal;
+	const Literal &r = right->literal;
+	Literal result;
+
+	switch (op) {
+	case OR:   setLiteral(cog, left, !l.isZero() || !r.isZero()); return true;
+	case XOR:  setLiteral(cog, left, !l.isZero() != !r.isZero()); return true;
+	case AND:  setLiteral(cog, left, !l.isZero() && !r.isZero()); return true;
+	case '<':  setLiteral(cog, left, l.compare(r) < 0); return true;
+	case '>':  setLiteral(cog, left, l.compare(r) > 0); return true;
+	case LE:   setLiteral(cog, left, l.compare(r) <= 0); return true;
+	case GE:   setLiteral(cog, left, l.compare(r) >= 0); return true;
+	case EQ:   setLiteral(cog, left, l.compare(r) == 0); return true;
+	case NE:   setLiteral(cog, left, l.compare(r) != 0); return true;
+	case '|':  setLiteral(cog, left, l.bitwiseOr(r)); return true;
+	case '^':  setLiteral(cog, left, l.bitwiseXor(r)); return true;
+	case '&':  setLiteral(cog, left, l.bitwiseAnd(r)); return true;
+	case '+':  setLiteral(cog, left, l.add(r)); return true;
+	case '-':  setLiteral(cog, left, l.sub(r)); return true;
+	case '*':  setLiteral(cog, left, l.mul(r)); return true;
+	case SHL:
+	case ASHR:
+	case LSHR:
+		// a logical shift of a negative value depends on its width, and the
+		// amount is kept small enough to fit in an int
+		if (!r.isInteger() || r.isNegative() || r.mantissa.getActiveBits() + r.exponent > 16
+		 || (op == LSHR && l.isNegative()))
+			return false;
+		if (op == SHL) {
+			setLiteral(cog, left, l.shift((int)r.mantissa.getZExtValue() << r.exponent));
+		} else {
+			// shifting an integer right drops its fraction, -3 >> 1 is -2
+			setLiteral(cog, left, l.shift(-((int)r.mantissa.getZExtValue() << r.exponent)).floor(std::min(l.exponent, 0)));
+		}
+		return true;
+	case '/':
+		if (!l.div(r, result)) {
+			error() << "division by zero in constant expression." << endl;
+			return false;
+		}
+		setLiteral(cog, left, result);
+		return true;
+	case '%':
+		if (!l.rem(r, result)) {
+			error() << "division by zero in constant expression." << endl;
+			return false;
+		}
+		setLiteral(cog, left, result);
+		return true;
+	}
+	return false;
+}
+
+Info *getBooleanOr(Compiler &cog, Info *left, Info *right)
 {
 	Typename booleanType = Typename::getBool();
-	unaryTypecheck(left, booleanType);
-	unaryTypecheck(right, booleanType);
+	unaryTypecheck(cog, left, booleanType);
+	unaryTypecheck(cog, right, booleanType);
 	left->value = cog.builder.CreateOr(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getBooleanXor(Info *left, Info *right)
+Info *getBooleanXor(Compiler &cog, Info *left, Info *right)
 {
 	Typename booleanType = Typename::getBool();
-	unaryTypecheck(left, booleanType);
-	unaryTypecheck(right, booleanType);
+	unaryTypecheck(cog, left, booleanType);
+	unaryTypecheck(cog, right, booleanType);
 	left->value = cog.builder.CreateXor(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getBooleanAnd(Info *left, Info *right)
+Info *getBooleanAnd(Compiler &cog, Info *left, Info *right)
 {
 	Typename booleanType = Typename::getBool();
-	unaryTypecheck(left, booleanType);
-	unaryTypecheck(right, booleanType);
+	unaryTypecheck(cog, left, booleanType);
+	unaryTypecheck(cog, right, booleanType);
 	left->value = cog.builder.CreateAnd(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getCmpLT(Info *left, Info *right)
+Info *getCmpLT(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFCmpOLT(left->value, right->value);
 	else if (lp->kind == PrimType::Unsigned)
@@ -331,12 +438,12 @@ Info *getCmpLT(Info *left, Info *right)
 	return left;
 }
 
-Info *getCmpGT(Info *left, Info *right)
+Info *getCmpGT(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFCmpOGT(left->value, right->value);
 	else if (lp->kind == PrimType::Unsigned)
@@ -348,12 +455,12 @@ Info *getCmpGT(Info *left, Info *right)
 	return left;
 }
 
-Info *getCmpLE(Info *left, Info *right)
+Info *getCmpLE(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFCmpOLE(left->value, right->value);
 	else if (lp->kind == PrimType::Unsigned)
@@ -365,12 +472,12 @@ Info *getCmpLE(Info *left, Info *right)
 	return left;
 }
 
-Info *getCmpGE(Info *left, Info *right)
+Info *getCmpGE(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFCmpOGE(left->value, right->value);
 	else if (lp->kind == PrimType::Unsigned)
@@ -382,12 +489,12 @@ Info *getCmpGE(Info *left, Info *right)
 	return left;
 }
 
-Info *getCmpEQ(Info *left, Info *right)
+Info *getCmpEQ(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFCmpOEQ(left->value, right->value);
 	else 
@@ -397,12 +504,12 @@ Info *getCmpEQ(Info *left, Info *right)
 	return left;
 }
 
-Info *getCmpNE(Info *left, Info *right)
+Info *getCmpNE(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFCmpUNE(left->value, right->value);
 	else 
@@ -412,60 +519,60 @@ Info *getCmpNE(Info *left, Info *right)
 	return left;
 }
 
-Info *getBitwiseOr(Info *left, Info *right)
+Info *getBitwiseOr(Compiler &cog, Info *left, Info *right)
 {
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	left->value = cog.builder.CreateOr(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getBitwiseXor(Info *left, Info *right)
+Info *getBitwiseXor(Compiler &cog, Info *left, Info *right)
 {
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	left->value = cog.builder.CreateXor(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getBitwiseAnd(Info *left, Info *right)
+Info *getBitwiseAnd(Compiler &cog, Info *left, Info *right)
 {
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	left->value = cog.builder.CreateAnd(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getShl(Info *left, Info *right)
+Info *getShl(Compiler &cog, Info *left, Info *right)
 {
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	left->value = cog.builder.CreateShl(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getAshr(Info *left, Info *right)
+Info *getAshr(Compiler &cog, Info *left, Info *right)
 {
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	left->value = cog.builder.CreateAShr(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getLshr(Info *left, Info *right)
+Info *getLshr(Compiler &cog, Info *left, Info *right)
 {
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	left->value = cog.builder.CreateLShr(left->value, right->value);
 	left->symbol = NULL;
 	return left;
 }
 
-Info *getRor(Info *left, Info *right)
+Info *getRor(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	llvm::Value *width = ConstantInt::get(lt, lt->getIntegerBitWidth());
 	llvm::Value *inv = cog.builder.CreateSub(width, right->value);
 	llvm::Value *lsb = cog.builder.CreateLShr(left->value, right->value);
@@ -475,12 +582,12 @@ Info *getRor(Info *left, Info *right)
 	return left;
 }
 
-Info *getRol(Info *left, Info *right)
+Info *getRol(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	llvm::Value *width = ConstantInt::get(lt, lt->getIntegerBitWidth());
 	llvm::Value *inv = cog.builder.CreateSub(width, right->value);
 	llvm::Value *lsb = cog.builder.CreateLShr(left->value, inv);
@@ -490,12 +597,12 @@ Info *getRol(Info *left, Info *right)
 	return left;
 }
 
-Info *getAdd(Info *left, Info *right)
+Info *getAdd(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFAdd(left->value, right->value);
 	else 
@@ -504,12 +611,12 @@ Info *getAdd(Info *left, Info *right)
 	return left;
 }
 
-Info *getSub(Info *left, Info *right)
+Info *getSub(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFSub(left->value, right->value);
 	else 
@@ -518,12 +625,12 @@ Info *getSub(Info *left, Info *right)
 	return left;
 }
 
-Info *getMult(Info *left, Info *right)
+Info *getMult(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFMul(left->value, right->value);
 	else
@@ -532,12 +639,12 @@ Info *getMult(Info *left, Info *right)
 	return left;
 }
 
-Info *getDiv(Info *left, Info *right)
+Info *getDiv(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFDiv(left->value, right->value);
 	else if (lp->kind == PrimType::Unsigned)
@@ -548,12 +655,12 @@ Info *getDiv(Info *left, Info *right)
 	return left;
 }
 
-Info *getRem(Info *left, Info *right)
+Info *getRem(Compiler &cog, Info *left, Info *right)
 {
 	PrimType *lp = left->type.prim;
 	llvm::Type *lt = lp->llvmType;
 
-	binaryTypecheck(left, right);
+	binaryTypecheck(cog, left, right);
 	if (lt->isFloatingPointTy())
 		left->value = cog.builder.CreateFRem(left->value, right->value);
 	else if (lp->kind == PrimType::Unsigned)
@@ -5,38 +5,43 @@
 namespace Cog
 {
 
-llvm::Value *castType(llvm::Value *value, Typename from, Typename to);
-Info *castType(Info *from, const Typename &to);
-int implicitCastDistance(const Typename &from, const Typename &to);
-void unaryTypecheck(Info *left, const Typename &expect);
-void binaryTypecheck(Info *left, Info *right);
-
-Info *getBooleanOr(Info *left, Info *right);
-Info *getBooleanXor(Info *left, Info *right);
-Info *getBooleanAnd(Info *left, Info *right);
-
-Info *getCmpLT(Info *left, Info *right);
-Info *getCmpGT(Info *left, Info *right);
-Info *getCmpLE(Info *left, Info *right);
-Info *getCmpGE(Info *left, Info *right);
-Info *getCmpEQ(Info *left, Info *right);
-Info *getCmpNE(Info *left, Info *right);
-
-Info *getBitwiseOr(Info *left, Info *right);
-Info *getBitwiseXor(Info *left, Info *right);
-Info *getBitwiseAnd(Info *left, Info *right);
-
-Info *getShl(Info *left, Info *right);
-Info *getAshr(Info *left, Info *right);
-Info *getLshr(Info *left, Info *right);
-Info *getRor(Info *left, Info *right);
-Info *getRol(Info *left, Info *right);
-
-Info *getAdd(Info *left, Info *right);
-Info *getSub(Info *left, Info *right);
-Info *getMult(Info *left, Info *right);
-Info *getDiv(Info *left, Info *right);
-Info *getRem(Info *left, Info *right);
+struct Compiler;
+
+llvm::Value *castType(Compiler &cog, llvm::Value *value, Typename from, Typename to);
+Info *castType(Compiler &cog, Info *from, const Typename &to);
+int implicitCastDistance(Compiler &cog, const Typename &from, const Typename &to);
+void unaryTypecheck(Compiler &cog, Info *left, const Typename &expect);
+void binaryTypecheck(Compiler &cog, Info *left, Info *right);
+
+bool foldUnaryOperator(Compiler &cog, int op, Info *arg);
+bool foldBinaryOperator(Compiler &cog, Info *left, int op, Info *right);
+
+Info *getBooleanOr(Compiler &cog, Info *left, Info *right);
+Info *getBooleanXor(Compiler &cog, Info *left, Info *right);
+Info *getBooleanAnd(Compiler &cog, Info *left, Info *right);
+
+Info *getCmpLT(Compiler &cog, Info *left, Info *right);
+Info *getCmpGT(Compiler &cog, Info *left, Info *right);
+Info *getCmpLE(Compiler &cog, Info *left, Info *right);
+Info *getCmpGE(Compiler &cog, Info *left, Info *right);
+Info *getCmpEQ(Compiler &cog, Info *left, Info *right);
+Info *getCmpNE(Compiler &cog, Info *left, Info *right);
+
+Info *getBitwiseOr(Compiler &cog, Info *left, Info *right);
+Info *getBitwiseXor(Compiler &cog, Info *left, Info *right);
+Info *getBitwiseAnd(Compiler &cog, Info *left, Info *right);
+
+Info *getShl(Compiler &cog, Info *left, Info *right);
+Info *getAshr(Compiler &cog, Info *left, Info *right);
+Info *getLshr(Compiler &cog, Info *left, Info *right);
+Info *getRor(Compiler &cog, Info *left, Info *right);
+Info *getRol(Compiler &cog, Info *left, Info *right);
+
+Info *getAdd(Compiler &cog, Info *left, Info *right);
+Info *getSub(Compiler &cog, Info *left, Info *right);
+Info *getMult(Compiler &cog, Info *left, Info *right);
+Info *getDiv(Compiler &cog, Info *left, Info *right);
+Info *getRem(Compiler &cog, Info *left, Info *right);
 
 }
 
@@ -3,41 +3,31 @@
 
 #include <llvm/IR/Constants.h>
 #include <sstream>
-
-extern Cog::Compiler cog;
+#include <algorithm>
+#include <string.h>
 
 namespace Cog
 {
 
-Scope::Scope()
+Branch::Branch(llvm::BasicBlock *block)
 {
+	this->block = block;
 }
 
-Scope::Scope(llvm::BasicBlock *block)
+Branch::~Branch()
 {
-	blocks.push_back(block);
-	curr = blocks.begin();
 }
 
-Scope::Scope(Scope *from)
+Scope::Scope()
 {
-	blocks.push_back(from->getBlock());
-	curr = blocks.begin();
-	for (std::vector<Symbol>::iterator i = from->symbols.begin(); i != from->symbols.end(); i++) {
-		symbols.push_back(Symbol(i->name, i->type));
-		symbols.back().inst = i->inst;
-		if (i->values.size() > 0) {
-			symbols.back().values.push_back(i->getValue());
-			symbols.back().curr = symbols.back().values.begin();
-		}
-	}
+	depth = 0;
 }
 
-Scope::Scope(const Scope &copy)
+Scope::Scope(llvm::BasicBlock *block)
 {
-	symbols = copy.symbols;
-	blocks = copy.blocks;
-	for (curr = blocks.begin(); curr != blocks.end() && *curr != *copy.curr; ++curr);
+	depth = 0;
+	blocks.push_back(Branch(block));
+	curr = blocks.begin();
 }
 
 Scope::~Scope()
@@ -46,89 +36,210 @@ Scope::~Scope()
 
 void Scope::nextBlock()
 {
-	for (int i = 0; i < (int)symbols.size(); i++)
-		symbols[i].nextValue();
 	++curr;
+	load();
 }
 
 void Scope::appendBlock(llvm::BasicBlock *block)
 {
-	for (int i = 0; i < (int)symbols.size(); i++)
-		symbols[i].values.push_back(symbols[i].getValue());
-	blocks.push_back(block);
+	blocks.push_back(Branch(block));
+	blocks.back().values = curr->values;
 }
 
 void Scope::dropBlock()
 {
-	for (int i = 0; i < (int)symbols.size(); i++)
-		symbols[i].values.pop_front();
 	blocks.pop_front();
 }
 
 void Scope::popBlock()
 {
-	for (int i = 0; i < (int)symbols.size(); i++)
-		symbols[i].popValue();
-	blocks.erase(curr++);
+	curr = blocks.erase(curr);
+	load();
 }
 
 void Scope::setBlock(llvm::BasicBlock *block)
 {
 	if (blocks.size() == 0) {
-		blocks.push_back(block);
+		blocks.push_back(Branch(block));
 		curr = blocks.begin();
 	} else {
-		*curr = block;
+		curr->block = block;
 	}
 }
 
 llvm::BasicBlock *Scope::getBlock()
 {
-	return *curr;
+	return curr->block;
 }
 
+/**
+ * Bind every symbol rebound in this scope to its value in the current branch.
+ * Symbols that this scope never rebound already hold the right value.
+ */
+void Scope::load()
+{
+	for (int i = 0; i < (int)rebound.size(); i++)
+		rebound[i]->value = getValue(*curr, rebound[i]);
+}
+
+/**
+ * Carry the rebindings of a nested scope over into the current branch of
+ * this one. Symbols declared by the nested scope go away with it.
+ */
 void Scope::merge(Scope *from)
 {
 	setBlock(from->getBlock());
-	for (int i = 0; i < (int)symbols.size() && i < (int)from->symbols.size(); i++) {
-		symbols[i].setValue(from->symbols[i].getValue());
+	for (int i = 0; i < (int)from->rebound.size(); i++) {
+		Symbol *symbol = from->rebound[i];
+		if (symbol->scope != from) {
+			if (entry.insert(std::pair<Symbol*, llvm::Value*>(symbol, from->entry[symbol])).second)
+				rebound.push_back(symbol);
+			curr->values[symbol] = symbol->value;
+			curr->changed.push_back(symbol);
+		}
 	}
-}	
+}
 
-Symbol* Scope::findSymbol(std::string name)
+void Scope::setValue(Symbol *symbol, llvm::Value *value)
 {
-	for (auto symbol = symbols.rbegin(); symbol != symbols.rend(); ++symbol) {
-		if (symbol->name == name) {
-			return &(*symbol);
-		}
+	if (entry.insert(std::pair<Symbol*, llvm::Value*>(symbol, symbol->value)).second)
+		rebound.push_back(symbol);
+	curr->values[symbol] = value;
+	curr->changed.push_back(symbol);
+	symbol->value = value;
+}
+
+llvm::Value *Scope::getValue(const Branch &branch, Symbol *symbol)
+{
+	auto value = branch.values.find(symbol);
+	if (value != branch.values.end())
+		return value->second;
+
+	value = entry.find(symbol);
+	if (value != entry.end())
+		return value->second;
+
+	return symbol->value;
+}
+
+/**
+ * Bind symbol to value in every branch of this scope, keeping the value it
+ * had when the scope was entered. Used for the header PHI of a loop that
+ * this scope contains, which the symbol has held since the header.
+ */
+void Scope::bindBranches(Symbol *symbol, llvm::Value *value)
+{
+	if (entry.insert(std::pair<Symbol*, llvm::Value*>(symbol, symbol->value)).second)
+		rebound.push_back(symbol);
+	for (auto branch = blocks.begin(); branch != blocks.end(); branch++)
+		branch->values[symbol] = value;
+}
+
+/**
+ * Make value the value symbol had when this scope was entered. Only valid
+ * for a symbol that this scope hasn't rebound, such as the header PHI of a
+ * loop this scope is inside.
+ */
+void Scope::bindEntry(Symbol *symbol, llvm::Value *value)
+{
+	if (entry.find(symbol) == entry.end())
+		rebound.push_back(symbol);
+	entry[symbol] = value;
+}
+
+/**
+ * Replace every binding of symbol to from, for a value that is deleted.
+ */
+void Scope::replaceValue(Symbol *symbol, llvm::Value *from, llvm::Value *to)
+{
+	auto value = entry.find(symbol);
+	if (value != entry.end() && value->second == from)
+		value->second = to;
+
+	for (auto branch = blocks.begin(); branch != blocks.end(); branch++) {
+		value = branch->values.find(symbol);
+		if (value != branch->values.end() && value->second == from)
+			value->second = to;
 	}
+}
 
-	return NULL;
+Loop::Loop(Scope *scope, llvm::BasicBlock *header, llvm::BasicBlock *entry)
+{
+	this->scope = scope;
+	this->header = header;
+	this->entry = entry;
 }
 
-Symbol *Scope::createSymbol(std::string name, Typename type)
+Loop::~Loop()
 {
-	symbols.push_back(Cog::Symbol(name, type));
-	return &symbols.back();
 }
 
 Info::Info()
 {
+	type = NULL;
 	args = NULL;
 	value = NULL;
 	symbol = NULL;
+	isLiteral = false;
 	next = NULL;
+	last = NULL;
 }
 
 Info::~Info()
 {
-	if (next != NULL)
-		delete next;
-	next = NULL;
+}
 
-	if (args != NULL)
-		delete args;
-	args = NULL;
+static const int pageSize = 1 << 16;
+
+Arena::Arena()
+{
+	used = 0;
+	page = 0;
+	offset = 0;
+}
+
+Arena::~Arena()
+{
+	for (int i = 0; i < (int)pages.size(); i++)
+		delete [] pages[i].first;
+	pages.clear();
+}
+
+Info *Arena::createInfo()
+{
+	if (used < (int)infos.size())
+		infos[used] = Info();
+	else
+		infos.push_back(Info());
+
+	return &infos[used++];
+}
+
+char *Arena::createString(const char *str, int length)
+{
+	while (page < (int)pages.size() && offset + length + 1 > pages[page].second) {
+		++page;
+		offset = 0;
+	}
+
+	if (page == (int)pages.size()) {
+		int size = std::max(pageSize, length + 1);
+		pages.push_back(std::pair<char*, int>(new char[size], size));
+		offset = 0;
+	}
+
+	char *result = pages[page].first + offset;
+	memcpy(result, str, length);
+	result[length] = '\0';
+	offset += length + 1;
+	return result;
+}
+
+void Arena::clear()
+{
+	used = 0;
+	page = 0;
+	offset = 0;
 }
 
 }
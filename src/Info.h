@@ -2,6 +2,7 @@
 
 #include "Type.h"
 #include "Variable.h"
+#include "Literal.h"
 
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Value.h>
@@ -10,22 +11,49 @@
 
 #include <vector>
 #include <list>
+#include <deque>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace Cog
 {
 
+struct Branch
+{
+	Branch(llvm::BasicBlock *block);
+	~Branch();
+
+	llvm::BasicBlock *block;
+
+	// The values of the symbols rebound in this branch. Symbols that are
+	// rebound in the scope but not in this branch keep their entry value.
+	std::unordered_map<Symbol*, llvm::Value*> values;
+
+	// the symbols rebound in this branch since it was appended, possibly
+	// with repeats. ifStatement only merges these.
+	std::vector<Symbol*> changed;
+};
+
 struct Scope
 {
 	Scope();
 	Scope(llvm::BasicBlock *block);
-	Scope(Scope *from);
-	Scope(const Scope &copy);
 	~Scope();
 
-	std::vector<Symbol> symbols;
-	std::list<llvm::BasicBlock*> blocks;
-	std::list<llvm::BasicBlock*>::iterator curr;
+	// the number of scopes enclosing this one
+	int depth;
+
+	// only the symbols declared in this scope, see Compiler::findSymbol for lookup
+	std::list<Symbol> symbols;
+
+	// The value each symbol had when this scope was entered, recorded the
+	// first time the symbol is rebound. rebound keeps these in a stable order.
+	std::unordered_map<Symbol*, llvm::Value*> entry;
+	std::vector<Symbol*> rebound;
+
+	std::list<Branch> blocks;
+	std::list<Branch>::iterator curr;
 
 	void nextBlock();
 	void appendBlock(llvm::BasicBlock *block);
@@ -34,10 +62,35 @@ struct Scope
 	void setBlock(llvm::BasicBlock *block);
 	llvm::BasicBlock *getBlock();
 
-	void merge(Scope *from);	
+	void load();
+	void merge(Scope *from);
 
-	Symbol *findSymbol(std::string name);
-	Symbol *createSymbol(Type *type, std::string name);
+	void setValue(Symbol *symbol, llvm::Value *value);
+	llvm::Value *getValue(const Branch &branch, Symbol *symbol);
+
+	void bindBranches(Symbol *symbol, llvm::Value *value);
+	void bindEntry(Symbol *symbol, llvm::Value *value);
+	void replaceValue(Symbol *symbol, llvm::Value *from, llvm::Value *to);
+};
+
+/**
+ * A while loop whose body is still being generated. The back edge into its
+ * header doesn't exist yet, so a symbol only gets a PHI there once the loop
+ * uses it, and whileStatement completes the PHIs when it seals the header.
+ */
+struct Loop
+{
+	Loop(Scope *scope, llvm::BasicBlock *header, llvm::BasicBlock *entry);
+	~Loop();
+
+	// the scope containing the while statement
+	Scope *scope;
+	llvm::BasicBlock *header;
+	llvm::BasicBlock *entry;
+
+	// the incomplete PHIs in header in the order they were created
+	std::vector<std::pair<Symbol*, llvm::PHINode*> > phis;
+	std::unordered_set<Symbol*> used;
 };
 
 struct Info
@@ -48,10 +101,40 @@ struct Info
 	std::string text;
 	Type *type;
 	llvm::Value *value;
-	Declaration *variable;
+	Symbol *symbol;
+
+	// set while this is a constant expression, value is then only the
+	// literal rounded to type
+	bool isLiteral;
+	Literal literal;
 	
 	Info *args;
 	Info *next;
+
+	// the tail of the list starting at this node, maintained by infoList
+	Info *last;
+};
+
+/**
+ * Owns the Info nodes and token strings of the semantic actions. Nothing
+ * allocated here is freed individually, clear() releases all of it at once
+ * and keeps the storage around for the next function.
+ */
+struct Arena
+{
+	Arena();
+	~Arena();
+
+	std::deque<Info> infos;
+	int used;
+
+	std::vector<std::pair<char*, int> > pages;
+	int page;
+	int offset;
+
+	Info *createInfo();
+	char *createString(const char *str, int length);
+	void clear();
 };
 
 }
@@ -0,0 +1,341 @@
+#include "Interface.h"
+#include "Cache.h"
+
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/ADT/StringExtras.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace Cog
+{
+
+// bumped whenever the layout changes
+static const char interfaceMagic[8] = { 'C', 'O', 'G', 'P', 'I', 'F', 'C', '1' };
+
+// FNV-1a, which is stored with each entry so it has to be stable
+static uint32_t hashName(const char *name)
+{
+	uint32_t hash = 2166136261u;
+	for (; *name; name++)
+		hash = (hash ^ (uint8_t)*name) * 16777619u;
+	return hash;
+}
+
+Interface::Interface()
+{
+	data = NULL;
+	size = 0;
+	header = NULL;
+	buckets = NULL;
+	entries = NULL;
+	nodes = NULL;
+	children = NULL;
+	strings = NULL;
+}
+
+Interface::~Interface()
+{
+	if (data)
+		munmap((void*)data, size);
+}
+
+/**
+ * Check that every offset in the tables of interface is in range and that
+ * the children of a node come before it, so lookup and load can trust them
+ * without checks of their own, and load always terminates.
+ */
+static bool isConsistent(const Interface &interface)
+{
+	const InterfaceHeader *header = interface.header;
+	if (header->bucketCount == 0 || (header->bucketCount & (header->bucketCount-1)) != 0)
+		return false;
+	if (interface.buckets[0] != 0 || interface.buckets[header->bucketCount] != header->entryCount)
+		return false;
+	for (uint32_t i = 0; i < header->bucketCount; i++)
+		if (interface.buckets[i] > interface.buckets[i+1])
+			return false;
+
+	// every string ends in the table, so it can be used where it is
+	if (header->stringSize > 0 && interface.strings[header->stringSize-1] != '\0')
+		return false;
+
+	for (uint32_t i = 0; i < header->entryCount; i++) {
+		const InterfaceEntry &entry = interface.entries[i];
+		if (entry.name < 0 || (uint32_t)entry.name >= header->stringSize ||
+		    entry.node < 0 || (uint32_t)entry.node >= header->nodeCount)
+			return false;
+	}
+
+	for (uint32_t i = 0; i < header->nodeCount; i++) {
+		const InterfaceNode &node = interface.nodes[i];
+		if (node.text < -1 || (node.text >= 0 && (uint32_t)node.text >= header->stringSize))
+			return false;
+		if (node.first < 0 || node.count < 0 || (uint64_t)node.first + node.count > header->childCount)
+			return false;
+		for (int j = 0; j < node.count; j++) {
+			int32_t child = interface.children[node.first + j];
+			if (child < -1 || (child >= 0 && (uint32_t)child >= i))
+				return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Map filename and check that it was built from the source with this hash.
+ * Returns false if it is missing, out of date, truncated or corrupt, in
+ * which case it has to be written again.
+ */
+bool Interface::open(const string &filename, const string &hash)
+{
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(InterfaceHeader)) {
+		::close(fd);
+		return false;
+	}
+
+	void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapped == MAP_FAILED)
+		return false;
+
+	// counted in 64 bits, so no count in the header can wrap it around
+	const InterfaceHeader *header = (const InterfaceHeader*)mapped;
+	uint64_t expected = sizeof(InterfaceHeader) + ((uint64_t)header->bucketCount+1)*sizeof(uint32_t) +
+		(uint64_t)header->entryCount*sizeof(InterfaceEntry) + (uint64_t)header->nodeCount*sizeof(InterfaceNode) +
+		(uint64_t)header->childCount*sizeof(int32_t) + header->stringSize;
+	if (memcmp(header->magic, interfaceMagic, sizeof(interfaceMagic)) != 0 || hash.size() != sizeof(header->hash) ||
+	    memcmp(header->hash, hash.data(), sizeof(header->hash)) != 0 || expected != (uint64_t)info.st_size) {
+		munmap(mapped, info.st_size);
+		return false;
+	}
+
+	data = (const char*)mapped;
+	size = info.st_size;
+	this->header = header;
+	buckets = (const uint32_t*)(data + sizeof(InterfaceHeader));
+	entries = (const InterfaceEntry*)(buckets + header->bucketCount+1);
+	nodes = (const InterfaceNode*)(entries + header->entryCount);
+	children = (const int32_t*)(nodes + header->nodeCount);
+	strings = (const char*)(children + header->childCount);
+	if (!isConsistent(*this)) {
+		munmap(mapped, size);
+		data = NULL;
+		size = 0;
+		this->header = NULL;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Add the node of every entry exported as name to found, one for each
+ * overload of a function.
+ */
+void Interface::lookup(const char *name, vector<int> &found) const
+{
+	uint32_t hash = hashName(name);
+	uint32_t bucket = hash & (header->bucketCount-1);
+	for (uint32_t i = buckets[bucket]; i < buckets[bucket+1]; i++)
+		if (entries[i].hash == hash && strcmp(strings + entries[i].name, name) == 0)
+			found.push_back(entries[i].node);
+}
+
+/**
+ * Copy the tree at index into into and return its index there. The text of
+ * the copy points into the mapping, which has to outlive into. The indices
+ * were checked by open.
+ */
+int Interface::load(int index, Ast &into) const
+{
+	const InterfaceNode &node = nodes[index];
+	vector<int> copies(node.count);
+	for (int i = 0; i < node.count; i++) {
+		int child = children[node.first + i];
+		copies[i] = child >= 0 ? load(child, into) : -1;
+	}
+
+	int result = into.create(node.kind, node.text >= 0 ? strings + node.text : NULL, node.token);
+	into.children.insert(into.children.end(), copies.begin(), copies.end());
+	into.nodes[result].count = node.count;
+	into.nodes[result].line = node.line;
+	return result;
+}
+
+/**
+ * Hash the compiler and the contents of source, which is what an interface
+ * depends on. Returns an empty string if source can't be read.
+ */
+string Interface::getHash(const string &source)
+{
+	auto contents = llvm::MemoryBuffer::getFile(source);
+	if (!contents)
+		return "";
+
+	return getHash((*contents)->getBufferStart(), (*contents)->getBufferSize());
+}
+
+string Interface::getHash(const char *contents, size_t size)
+{
+	llvm::SHA1 hash;
+	hash.update(string(compilerVersion) + '\0');
+	hash.update(llvm::StringRef(contents, size));
+	return llvm::toHex(hash.final(), true);
+}
+
+/**
+ * The file path refers to when source imports it, which is relative to the
+ * directory of source.
+ */
+string Interface::resolve(const string &source, const string &path)
+{
+	size_t slash = source.find_last_of('/');
+	if ((path.size() > 0 && path[0] == '/') || slash == string::npos)
+		return path;
+	return source.substr(0, slash+1) + path;
+}
+
+/**
+ * The files source imports, found by scanning its contents rather than
+ * parsing them. This may find imports in comments too, which only costs
+ * the callers some extra work.
+ */
+vector<string> Interface::findImports(const string &source, const char *contents, size_t size)
+{
+	llvm::StringRef text(contents, size);
+	vector<string> paths;
+	for (size_t at = text.find("import"); at != llvm::StringRef::npos; at = text.find("import", at+6)) {
+		size_t quote = text.find_first_not_of(" \t\r\n", at+6);
+		if (quote == llvm::StringRef::npos || text[quote] != '"')
+			continue;
+
+		size_t end = text.find('"', quote+1);
+		if (end == llvm::StringRef::npos)
+			break;
+		paths.push_back(resolve(source, text.substr(quote+1, end-quote-1).str()));
+	}
+	return paths;
+}
+
+/**
+ * Builds the tables of an interface before they are written out.
+ */
+struct InterfaceWriter
+{
+	const Ast &ast;
+	vector<InterfaceEntry> entries;
+	vector<InterfaceNode> nodes;
+	vector<int32_t> children;
+	string strings;
+
+	InterfaceWriter(const Ast &ast) : ast(ast)
+	{
+	}
+
+	int32_t addString(const char *text)
+	{
+		if (!text)
+			return -1;
+
+		int32_t offset = (int32_t)strings.size();
+		strings.append(text, strlen(text)+1);
+		return offset;
+	}
+
+	// the children of a node have to be contiguous, so they are stored first
+	int32_t addNode(int index)
+	{
+		const Node &node = ast.get(index);
+		vector<int32_t> copies(node.count);
+		for (int i = 0; i < node.count; i++) {
+			int child = ast.child(node, i);
+			copies[i] = child >= 0 ? addNode(child) : -1;
+		}
+
+		InterfaceNode stored = { node.kind, node.token, addString(node.text), node.line, (int32_t)children.size(), node.count };
+		children.insert(children.end(), copies.begin(), copies.end());
+		nodes.push_back(stored);
+		return (int32_t)nodes.size()-1;
+	}
+
+	void addEntry(int index)
+	{
+		const Node &node = ast.get(index);
+		InterfaceEntry entry = { hashName(node.text), addString(node.text), addNode(index) };
+		entries.push_back(entry);
+	}
+};
+
+/**
+ * Write the interface of the file ast was parsed from, whose source has
+ * hash, to filename. A function definition only exports its prototype.
+ * Imports of the file aren't exported again.
+ */
+bool Interface::write(const Ast &ast, const string &hash, const string &filename)
+{
+	InterfaceWriter writer(ast);
+	for (int i = 0; i < (int)ast.blocks.size(); i++) {
+		const Node &node = ast.get(ast.blocks[i]);
+		if (node.kind == STRUCTURE_NODE || node.kind == PROTOTYPE_NODE)
+			writer.addEntry(ast.blocks[i]);
+		else if (node.kind == FUNCTION_NODE)
+			writer.addEntry(ast.child(node, 0));
+	}
+
+	InterfaceHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, interfaceMagic, sizeof(interfaceMagic));
+	memcpy(header.hash, hash.data(), min(hash.size(), sizeof(header.hash)));
+	header.bucketCount = 1;
+	while (header.bucketCount < writer.entries.size())
+		header.bucketCount <<= 1;
+	header.entryCount = writer.entries.size();
+	header.nodeCount = writer.nodes.size();
+	header.childCount = writer.children.size();
+	header.stringSize = writer.strings.size();
+
+	// sort the entries into their buckets, keeping source order in each
+	vector<uint32_t> buckets(header.bucketCount+1, 0);
+	for (size_t i = 0; i < writer.entries.size(); i++)
+		buckets[(writer.entries[i].hash & (header.bucketCount-1)) + 1]++;
+	for (uint32_t i = 0; i < header.bucketCount; i++)
+		buckets[i+1] += buckets[i];
+
+	vector<InterfaceEntry> entries(writer.entries.size());
+	vector<uint32_t> next(buckets.begin(), buckets.end()-1);
+	for (size_t i = 0; i < writer.entries.size(); i++)
+		entries[next[writer.entries[i].hash & (header.bucketCount-1)]++] = writer.entries[i];
+
+	string temp = getTempName(filename);
+	FILE *file = fopen(temp.c_str(), "wb");
+	if (!file)
+		return false;
+
+	bool result = fwrite(&header, sizeof(header), 1, file) == 1;
+	result = fwrite(buckets.data(), sizeof(uint32_t), buckets.size(), file) == buckets.size() && result;
+	result = fwrite(entries.data(), sizeof(InterfaceEntry), entries.size(), file) == entries.size() && result;
+	result = fwrite(writer.nodes.data(), sizeof(InterfaceNode), writer.nodes.size(), file) == writer.nodes.size() && result;
+	result = fwrite(writer.children.data(), sizeof(int32_t), writer.children.size(), file) == writer.children.size() && result;
+	result = fwrite(writer.strings.data(), 1, writer.strings.size(), file) == writer.strings.size() && result;
+	result = fclose(file) == 0 && result;
+
+	if (!result || rename(temp.c_str(), filename.c_str()) != 0) {
+		remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Ast.h"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace Cog
+{
+
+struct InterfaceHeader
+{
+	char magic[8];
+	// see Interface::getHash
+	char hash[40];
+
+	uint32_t bucketCount;
+	uint32_t entryCount;
+	uint32_t nodeCount;
+	uint32_t childCount;
+	uint32_t stringSize;
+};
+
+// one exported structure or function signature
+struct InterfaceEntry
+{
+	uint32_t hash;
+	// offsets into the string table and the node table
+	int32_t name;
+	int32_t node;
+};
+
+// a Node whose text is an offset into the string table, or -1
+struct InterfaceNode
+{
+	int32_t kind;
+	int32_t token;
+	int32_t text;
+	int32_t line;
+	int32_t first;
+	int32_t count;
+};
+
+/**
+ * The precompiled interface of a source file: the syntax trees of its
+ * structures and function signatures without the function bodies, and a
+ * hash index of the names they export. It is written next to the source as
+ * file.cog.pifc and mapped read only by every importer, which only copies
+ * out the entries it refers to. The file is laid out as the header, then
+ * bucketCount+1 bucket offsets into the entries, the entries sorted by
+ * bucket, the nodes, their children and the strings.
+ */
+struct Interface
+{
+	Interface();
+	~Interface();
+
+	// the mapping, NULL until open succeeds
+	const char *data;
+	size_t size;
+
+	const InterfaceHeader *header;
+	const uint32_t *buckets;
+	const InterfaceEntry *entries;
+	const InterfaceNode *nodes;
+	const int32_t *children;
+	const char *strings;
+
+	bool open(const std::string &filename, const std::string &hash);
+	void lookup(const char *name, std::vector<int> &found) const;
+	int load(int index, Ast &into) const;
+
+	static std::string getHash(const std::string &source);
+	static std::string getHash(const char *contents, size_t size);
+	static bool write(const Ast &ast, const std::string &hash, const std::string &filename);
+
+	static std::string resolve(const std::string &source, const std::string &path);
+	static std::vector<std::string> findImports(const std::string &source, const char *contents, size_t size);
+};
+
+}
@@ -1,17 +1,10 @@
 #include "Intrinsic.h"
 #include "Compiler.h"
 
-extern Cog::Compiler cog;
-extern int line;
-extern int column;
-extern const char *str;
-
-
-
 namespace Cog
 {
 
-llvm::Value *fn_abs(llvm::Value *v0)
+llvm::Value *fn_abs(Compiler &cog, llvm::Value *v0)
 {
 	llvm::Value *lt0 = cog.builder.CreateICmpSLT(v0, ConstantInt::get(v0->getType(), 0));
 	return cog.builder.CreateSelect(lt0, cog.builder.CreateNeg(v0), v0);
@@ -32,7 +25,7 @@ llvm::Value *fn_abs(llvm::Value *v0)
  * ashr -> and -> add -> ashr
  * (cmplz, add) -> cmov -> ashr 
  */
-llvm::Value *fn_div2(llvm::Value *v0, int shift)
+llvm::Value *fn_div2(Compiler &cog, llvm::Value *v0, int shift)
 {
 	int mask = ((1 << shift)-1);
 
@@ -42,7 +35,7 @@ llvm::Value *fn_div2(llvm::Value *v0, int shift)
 	return cog.builder.CreateAShr(sel, shift);
 }
 
-void fn_exit(llvm::Value *exitCode)
+void fn_exit(Compiler &cog, llvm::Value *exitCode)
 {
 	vector<llvm::Type*> argTypes;
 	vector<llvm::Value*> argValues;
@@ -12,8 +12,10 @@
 namespace Cog
 {
 
-llvm::Value *fn_abs(llvm::Value *v0);
-llvm::Value *fn_div2(llvm::Value *v0, int shift);
+struct Compiler;
+
+llvm::Value *fn_abs(Compiler &cog, llvm::Value *v0);
+llvm::Value *fn_div2(Compiler &cog, llvm::Value *v0, int shift);
 
 }
 
@@ -0,0 +1,261 @@
+#include "Json.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+namespace Cog
+{
+
+static const Json nullJson;
+
+Json::Json()
+{
+	kind = NULL_JSON;
+	boolean = false;
+	number = 0;
+}
+
+Json::~Json()
+{
+}
+
+const Json &Json::operator[](const char *name) const
+{
+	for (size_t i = 0; i < members.size(); i++)
+		if (members[i].first == name)
+			return members[i].second;
+	return nullJson;
+}
+
+const Json &Json::operator[](size_t index) const
+{
+	return index < elements.size() ? elements[index] : nullJson;
+}
+
+int Json::asInt() const
+{
+	return (int)number;
+}
+
+string Json::write() const
+{
+	switch (kind) {
+	case BOOLEAN_JSON:
+		return boolean ? "true" : "false";
+	case NUMBER_JSON: {
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.17g", number);
+		return buffer;
+	}
+	case STRING_JSON:
+		return "\"" + escapeJson(string) + "\"";
+	case ARRAY_JSON: {
+		std::string result = "[";
+		for (size_t i = 0; i < elements.size(); i++)
+			result += (i > 0 ? "," : "") + elements[i].write();
+		return result + "]";
+	}
+	case OBJECT_JSON: {
+		std::string result = "{";
+		for (size_t i = 0; i < members.size(); i++)
+			result += (i > 0 ? ",\"" : "\"") + escapeJson(members[i].first) + "\":" + members[i].second.write();
+		return result + "}";
+	}
+	}
+	return "null";
+}
+
+static void skipSpace(const char *&curr)
+{
+	while (*curr == ' ' || *curr == '\t' || *curr == '\r' || *curr == '\n')
+		curr++;
+}
+
+static void appendUtf8(string &str, unsigned code)
+{
+	if (code < 0x80)
+		str += (char)code;
+	else if (code < 0x800) {
+		str += (char)(0xC0 | code >> 6);
+		str += (char)(0x80 | (code & 0x3F));
+	} else if (code < 0x10000) {
+		str += (char)(0xE0 | code >> 12);
+		str += (char)(0x80 | (code >> 6 & 0x3F));
+		str += (char)(0x80 | (code & 0x3F));
+	} else {
+		str += (char)(0xF0 | code >> 18);
+		str += (char)(0x80 | (code >> 12 & 0x3F));
+		str += (char)(0x80 | (code >> 6 & 0x3F));
+		str += (char)(0x80 | (code & 0x3F));
+	}
+}
+
+static bool parseHex(const char *&curr, unsigned &code)
+{
+	code = 0;
+	for (int i = 0; i < 4; i++, curr++) {
+		char c = *curr;
+		if (c >= '0' && c <= '9')
+			code = code*16 + (c - '0');
+		else if (c >= 'a' && c <= 'f')
+			code = code*16 + (c - 'a' + 10);
+		else if (c >= 'A' && c <= 'F')
+			code = code*16 + (c - 'A' + 10);
+		else
+			return false;
+	}
+	return true;
+}
+
+static bool parseString(const char *&curr, string &str)
+{
+	if (*curr++ != '"')
+		return false;
+
+	while (*curr != '"') {
+		if (*curr == 0)
+			return false;
+		if (*curr != '\\') {
+			str += *curr++;
+			continue;
+		}
+
+		curr++;
+		switch (*curr++) {
+		case '"': str += '"'; break;
+		case '\\': str += '\\'; break;
+		case '/': str += '/'; break;
+		case 'b': str += '\b'; break;
+		case 'f': str += '\f'; break;
+		case 'n': str += '\n'; break;
+		case 'r': str += '\r'; break;
+		case 't': str += '\t'; break;
+		case 'u': {
+			unsigned code, low;
+			if (!parseHex(curr, code))
+				return false;
+			// a surrogate pair
+			if (code >= 0xD800 && code < 0xDC00 && curr[0] == '\\' && curr[1] == 'u') {
+				curr += 2;
+				if (!parseHex(curr, low))
+					return false;
+				code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+			}
+			appendUtf8(str, code);
+			break;
+		}
+		default:
+			return false;
+		}
+	}
+	curr++;
+	return true;
+}
+
+static bool parseValue(const char *&curr, Json &value)
+{
+	skipSpace(curr);
+	if (*curr == '{') {
+		value.kind = OBJECT_JSON;
+		curr++;
+		skipSpace(curr);
+		if (*curr == '}') {
+			curr++;
+			return true;
+		}
+		while (true) {
+			value.members.push_back(pair<string, Json>());
+			skipSpace(curr);
+			if (!parseString(curr, value.members.back().first))
+				return false;
+			skipSpace(curr);
+			if (*curr++ != ':' || !parseValue(curr, value.members.back().second))
+				return false;
+			skipSpace(curr);
+			if (*curr == '}') {
+				curr++;
+				return true;
+			}
+			if (*curr++ != ',')
+				return false;
+		}
+	} else if (*curr == '[') {
+		value.kind = ARRAY_JSON;
+		curr++;
+		skipSpace(curr);
+		if (*curr == ']') {
+			curr++;
+			return true;
+		}
+		while (true) {
+			value.elements.push_back(Json());
+			if (!parseValue(curr, value.elements.back()))
+				return false;
+			skipSpace(curr);
+			if (*curr == ']') {
+				curr++;
+				return true;
+			}
+			if (*curr++ != ',')
+				return false;
+		}
+	} else if (*curr == '"') {
+		value.kind = STRING_JSON;
+		return parseString(curr, value.string);
+	} else if (strncmp(curr, "true", 4) == 0 || strncmp(curr, "false", 5) == 0) {
+		value.kind = BOOLEAN_JSON;
+		value.boolean = *curr == 't';
+		curr += value.boolean ? 4 : 5;
+		return true;
+	} else if (strncmp(curr, "null", 4) == 0) {
+		curr += 4;
+		return true;
+	}
+
+	char *end;
+	value.kind = NUMBER_JSON;
+	value.number = strtod(curr, &end);
+	if (end == curr)
+		return false;
+	curr = end;
+	return true;
+}
+
+/**
+ * Parse text into value. Returns false if it isn't a single JSON value.
+ */
+bool Json::parse(const std::string &text, Json &value)
+{
+	const char *curr = text.c_str();
+	if (!parseValue(curr, value))
+		return false;
+	skipSpace(curr);
+	return *curr == 0;
+}
+
+string escapeJson(const string &str)
+{
+	string result;
+	for (size_t i = 0; i < str.size(); i++) {
+		unsigned char c = str[i];
+		if (c == '"' || c == '\\') {
+			result += '\\';
+			result += c;
+		} else if (c == '\n')
+			result += "\\n";
+		else if (c == '\t')
+			result += "\\t";
+		else if (c < ' ') {
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			result += buffer;
+		} else
+			result += c;
+	}
+	return result;
+}
+
+}
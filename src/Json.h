@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace Cog
+{
+
+enum JsonKind
+{
+	NULL_JSON,
+	BOOLEAN_JSON,
+	NUMBER_JSON,
+	STRING_JSON,
+	ARRAY_JSON,
+	OBJECT_JSON
+};
+
+/**
+ * A parsed JSON value, only as much as the language server needs to read
+ * its requests. Responses are put together as text, see escapeJson.
+ */
+struct Json
+{
+	Json();
+	~Json();
+
+	// a JsonKind
+	int kind;
+	bool boolean;
+	double number;
+	std::string string;
+	std::vector<Json> elements;
+	std::vector<std::pair<std::string, Json> > members;
+
+	// the member called name, or a null value if there is none
+	const Json &operator[](const char *name) const;
+	const Json &operator[](size_t index) const;
+	int asInt() const;
+
+	std::string write() const;
+	static bool parse(const std::string &text, Json &value);
+};
+
+// str as the contents of a JSON string, without the quotes
+std::string escapeJson(const std::string &str);
+
+}
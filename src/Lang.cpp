@@ -9,8 +9,7 @@
 #include <iostream>
 #include <sstream>
 #include <llvm/ADT/Twine.h>
-
-extern Cog::Compiler cog;
+#include <llvm/IR/ValueHandle.h>
 
 using std::endl;
 
@@ -38,13 +37,13 @@ APInt APInt_pow(APInt base, unsigned int exp)
     return result;
 }
 
-Info *getTypename(int token, char *txt)
+Info *getTypename(Compiler &cog, int token, char *txt)
 {
 	// TODO fixed point integer math set precision
 	// TODO pointer types
 	// TODO structure types
 	// TODO interface types
-	Info *result = new Info();
+	Info *result = cog.arena.createInfo();
 	if (token == VOID_PRIMITIVE) {
 		result->type = Typename::getVoid();
 	} else if (token == BOOL_PRIMITIVE) {
@@ -67,24 +66,19 @@ Info *getTypename(int token, char *txt)
 		error() << "undefined type." << endl;
 	}
 
-	delete txt;
 	if (result->type.isSet())
 		return result;
-	else {
-		delete result;
+	else
 		return NULL;
-	}
 }
 
-Info *getStaticArrayTypename(Info *name, Info *size)
+Info *getStaticArrayTypename(Compiler &cog, Info *name, Info *size)
 {
 	int64_t size_value = 0;
 	if (ConstantInt *size_cnst = dyn_cast<ConstantInt>(size->value)) {
 		size_value = size_cnst->getSExtValue();
 	} else {
 		error() << "static array size must be a constant expression." << endl;
-		delete name;
-		delete size;
 		return NULL;
 	}
 
@@ -96,18 +90,13 @@ Info *getStaticArrayTypename(Info *name, Info *size)
 			name->type.base->llvmType = llvm::ArrayType::get(name->type.base->llvmType, size_value);
 	} else {
 		error() << "array size must be non-negative." << endl;
-		delete name;
-		delete size;
 		return NULL;
 	}
 
-	if (size)
-		delete size;
-
 	return name;
 }
 
-Info *getDynamicArrayTypename(Info *name)
+Info *getDynamicArrayTypename(Compiler &cog, Info *name)
 {
 	name->type.modifiers.push_back(Typename::DYNAMIC_ARRAY);
 	if (name->type.prim != NULL)
@@ -118,7 +107,7 @@ Info *getDynamicArrayTypename(Info *name)
 	return name;
 }
 
-Info *getPointerTypename(Info *name)
+Info *getPointerTypename(Compiler &cog, Info *name)
 {
 	name->type.modifiers.push_back(Typename::POINTER);
 	if (name->type.prim != NULL)
@@ -129,9 +118,9 @@ Info *getPointerTypename(Info *name)
 	return name;
 }
 
-Info *getConstant(int64_t cnst)
+Info *getConstant(Compiler &cog, int64_t cnst)
 {
-	Info *result = new Info();
+	Info *result = cog.arena.createInfo();
 	
 	APInt value(64, (uint64_t)cnst, cnst < 0);
 	int valueShift = value.countTrailingZeros();
@@ -144,13 +133,15 @@ Info *getConstant(int64_t cnst)
 	else
 		result->type = Typename::getUFixed(value.getBitWidth(), exponent);
 	result->value = ConstantInt::get(result->type.getLlvm(), value);
+	result->isLiteral = true;
+	result->literal = Literal(APInt(64, (uint64_t)cnst, true), 0, true);
 	
 	return result;
 }
 
-Info *getConstant(int token, char *txt)
+Info *getConstant(Compiler &cog, int token, char *txt)
 {
-	Info *result = new Info();
+	Info *result = cog.arena.createInfo();
 	
 	char *curr = txt;
 	bool isFractional = false;
@@ -172,7 +163,8 @@ Info *getConstant(int token, char *txt)
 			result->value = ConstantInt::get(result->type.getLlvm(), 1);
 		else
 			result->value = ConstantInt::get(result->type.getLlvm(), 0);
-		delete txt;
+		result->isLiteral = true;
+		result->literal = Literal(APInt(1, result->value == ConstantInt::getTrue(result->type.getLlvm()) ? 1 : 0), 0, false);
 		return result;
 	case HEX_CONSTANT:
 		radix = 16;
@@ -201,8 +193,6 @@ Info *getConstant(int token, char *txt)
 		break;
 	default:
 		error() << "unrecognized constant token." << endl;
-		delete txt;
-		delete result;
 		return NULL;
 	}
 	
@@ -252,34 +242,114 @@ Info *getConstant(int token, char *txt)
 	else
 		result->type = Typename::getUFixed(value.getBitWidth(), exponent);
 	result->value = ConstantInt::get(result->type.getLlvm(), value);
+	// value has already wrapped if it is negative, the magnitude has not
+	result->isLiteral = true;
+	result->literal = Literal(isNegative ? -value : value, exponent, false);
+	if (isNegative)
+		result->literal = result->literal.neg();
 
 	//printf("%s: %s\n", result->type.getName().c_str(), value.toString(10, false).c_str());
 	
-	delete txt;
 	return result;
 }
 
-Info *getIdentifier(char *txt)
+/**
+ * Give symbol a PHI in the header of each open loop it was declared outside
+ * of, the first time that loop uses it. Since the loop hasn't used the symbol
+ * before, the PHI is retroactively its value everywhere after the header.
+ */
+static void useSymbol(Compiler &cog, Symbol *symbol)
 {
-	Symbol *symbol = cog.getScope()->findSymbol(txt);
+	for (int i = 0; i < (int)cog.loops.size(); i++) {
+		Loop &loop = cog.loops[i];
+		// declared inside this loop, but maybe outside one nested in it
+		if (symbol->scope->depth > loop.scope->depth)
+			continue;
+		if (!loop.used.insert(symbol).second)
+			continue;
+
+		TraceTotal total(cog.trace, "PHI construction (us)");
+		PHINode *phi = PHINode::Create(symbol->type->llvmType, 2, symbol->name + "_");
+		loop.header->getInstList().push_front(phi);
+		phi->addIncoming(symbol->getValue(), loop.entry);
+		loop.phis.push_back(std::pair<Symbol*, PHINode*>(symbol, phi));
+		cog.trace.count("PHIs");
+
+		for (auto scope = cog.scopes.begin(); scope != cog.scopes.end(); scope++) {
+			if (&(*scope) == loop.scope)
+				scope->bindBranches(symbol, phi);
+			else if (scope->depth > loop.scope->depth)
+				scope->bindEntry(symbol, phi);
+		}
+		symbol->value = phi;
+	}
+}
+
+/**
+ * Replace phi by its only incoming value other than itself, if it has one,
+ * then retry the PHIs that used it. Every value merged by phi belongs to
+ * symbol, and so do the PHIs using it.
+ */
+static void removeTrivialPhi(Compiler &cog, Symbol *symbol, PHINode *phi)
+{
+	Value *same = NULL;
+	for (unsigned i = 0; i < phi->getNumIncomingValues(); i++) {
+		Value *value = phi->getIncomingValue(i);
+		if (value == same || value == phi)
+			continue;
+		if (same != NULL)
+			return;
+		same = value;
+	}
+
+	if (same == NULL)
+		same = UndefValue::get(phi->getType());
+
+	// removing one of these may remove another, so hold them weakly
+	std::vector<WeakVH> users;
+	for (auto user = phi->user_begin(); user != phi->user_end(); user++)
+		if (*user != phi && isa<PHINode>(*user))
+			users.push_back(WeakVH(*user));
+
+	phi->replaceAllUsesWith(same);
+	for (auto scope = cog.scopes.begin(); scope != cog.scopes.end(); scope++)
+		scope->replaceValue(symbol, phi, same);
+	if (symbol->value == phi)
+		symbol->value = same;
+	phi->eraseFromParent();
+	cog.trace.count("trivial PHIs");
+
+	for (int i = 0; i < (int)users.size(); i++)
+		if (PHINode *user = dyn_cast_or_null<PHINode>((Value*)users[i]))
+			removeTrivialPhi(cog, symbol, user);
+}
+
+Info *getIdentifier(Compiler &cog, char *txt)
+{
+	Symbol *symbol = cog.findSymbol(txt);
 	if (symbol) {
-		Info *result = new Info();
+		if (!cog.loops.empty())
+			useSymbol(cog, symbol);
+
+		Info *result = cog.arena.createInfo();
 		result->symbol = symbol;
 		result->value = symbol->getValue();
 		result->type = result->symbol->type;
-		delete txt;
 		return result;
 	}
 
 	error() << "undefined variable '" << txt << "'." << endl;
-	delete txt;
 	return NULL;
 }
 
-Info *unaryOperator(int op, Info *arg)
+Info *unaryOperator(Compiler &cog, int op, Info *arg)
 {
 	if (arg != NULL) {
 		if (arg->type.prim) {
+			if (foldUnaryOperator(cog, op, arg))
+				return arg;
+
+			arg->isLiteral = false;
 			switch (op) {
 				case '-':
 					arg->value = cog.builder.CreateNeg(arg->value);
@@ -289,23 +359,20 @@ Info *unaryOperator(int op, Info *arg)
 					arg->value = cog.builder.CreateNot(arg->value);
 					break;
 				case NOT:
-					unaryTypecheck(arg, Typename::getBool());
+					unaryTypecheck(cog, arg, Typename::getBool());
 					arg->value = cog.builder.CreateNot(arg->value);
 					break;
 				default:
 					error() << "unrecognized unary operator '" << (char)op << "'." << endl;
-					delete arg;
 					return NULL;
 			}
 			arg->symbol = NULL;
 			return arg;
 		} else if (arg->type.base) {
 			error() << "operators on structures not yet supported" << endl;
-			delete arg;
 			return NULL;
 		} else {
 			error() << "not a valid type" << endl;
-			delete arg;
 			return NULL;
 		}
 	} else {
@@ -314,339 +381,329 @@ Info *unaryOperator(int op, Info *arg)
 	}
 }
 
-Info *binaryOperator(Info *left, int op, Info *right)
+Info *binaryOperator(Compiler &cog, Info *left, int op, Info *right)
 {
 	if (left && right) {
 		if (left->type.prim && right->type.prim) {
+			if (foldBinaryOperator(cog, left, op, right))
+				return left;
+
 			switch (op) {
-			case OR:   getBooleanOr(left, right); break;
-			case XOR:  getBooleanXor(left, right); break;
-			case AND:  getBooleanAnd(left, right); break;
-			case '<':  getCmpLT(left, right); break;
-			case '>':  getCmpGT(left, right); break;
-			case LE:   getCmpLE(left, right); break;
-			case GE:   getCmpGE(left, right); break;
-			case EQ:   getCmpEQ(left, right); break;
-			case NE:   getCmpNE(left, right); break;
-			case '|':  getBitwiseOr(left, right); break;
-			case '^':  getBitwiseXor(left, right); break;
-			case '&':  getBitwiseAnd(left, right); break;
-			case SHL:  getShl(left, right); break;
-			case ASHR: getAshr(left, right); break;
-			case LSHR: getLshr(left, right); break;
-			case ROR:  getRor(left, right); break;
-			case ROL:  getRol(left, right); break;
-			case '+':  getAdd(left, right); break;
-			case '-':  getSub(left, right); break;
-			case '*':  getMult(left, right); break;
-			case '/':  getDiv(left, right); break;
-			case '%':  getRem(left, right); break;
+			case OR:   getBooleanOr(cog, left, right); break;
+			case XOR:  getBooleanXor(cog, left, right); break;
+			case AND:  getBooleanAnd(cog, left, right); break;
+			case '<':  getCmpLT(cog, left, right); break;
+			case '>':  getCmpGT(cog, left, right); break;
+			case LE:   getCmpLE(cog, left, right); break;
+			case GE:   getCmpGE(cog, left, right); break;
+			case EQ:   getCmpEQ(cog, left, right); break;
+			case NE:   getCmpNE(cog, left, right); break;
+			case '|':  getBitwiseOr(cog, left, right); break;
+			case '^':  getBitwiseXor(cog, left, right); break;
+			case '&':  getBitwiseAnd(cog, left, right); break;
+			case SHL:  getShl(cog, left, right); break;
+			case ASHR: getAshr(cog, left, right); break;
+			case LSHR: getLshr(cog, left, right); break;
+			case ROR:  getRor(cog, left, right); break;
+			case ROL:  getRol(cog, left, right); break;
+			case '+':  getAdd(cog, left, right); break;
+			case '-':  getSub(cog, left, right); break;
+			case '*':  getMult(cog, left, right); break;
+			case '/':  getDiv(cog, left, right); break;
+			case '%':  getRem(cog, left, right); break;
 			default:
 				error() << "unrecognized binary operator '" << (char)op << "'." << endl;
-				delete left;
-				delete right;
 				return NULL;
 			}
+			left->isLiteral = false;
 		}
-		delete right;
 		return left;
 	} else {
 		error() << "here" << endl;
-		if (left)
-			delete left;
-		if (right)
-			delete right;
 		return NULL;
 	}
 }
 
-void declareSymbol(Info *type, char *name)
+void declareSymbol(Compiler &cog, Info *type, char *name)
 {
 	if (type && name) {
-		if (cog.getScope()->findSymbol(name) != NULL) {
+		if (cog.findSymbol(name) != NULL) {
 			error() << "variable '" << name << "' already defined." << endl;
 		}
 
-		cog.getScope()->createSymbol(name, type->type);
-
-		delete type;
-		delete name;
+		cog.createSymbol(type->type, name);
 	} else {
 		error() << "here" << endl;
-		if (type)
-			delete type;
-		if (name)
-			delete name;
 		// something is broken
 	}
 }
 
 
-void declareSymbols(Info *type, Info *names)
+void declareSymbols(Compiler &cog, Info *type, Info *names)
 {
 	if (type && names) {
 		Info *curr = names;
 		while (curr != NULL) {
-			printf("%s\n", curr->text.c_str());
-			if (cog.getScope()->findSymbol(curr->text) != NULL) {
+			if (cog.findSymbol(cog.intern(curr->text)) != NULL) {
 				error() << "variable '" << curr->text << "' already defined." << endl;
 			}
 
-			Symbol *symbol = cog.getScope()->createSymbol(curr->text, type->type);
+			Symbol *symbol = cog.createSymbol(type->type, curr->text);
 
 			if (curr->value) {
-				unaryTypecheck(curr, symbol->type);
-				symbol->setValue(curr->value);
+				unaryTypecheck(cog, curr, symbol->type);
+				cog.getScope()->setValue(symbol, curr->value);
 				curr->value->setName(symbol->name);
 			}
 			curr = curr->next;
 		}
-
-		delete type;
-		delete names;
 	} else {
 		error() << "here" << endl;
-		if (type)
-			delete type;
-		if (names)
-			delete names;
 		// something is broken
 	}
 }
 
-void assignSymbol(Info *left, int op, Info *right)
+void assignSymbol(Compiler &cog, Info *left, int op, Info *right)
 {
 	if (left && right) {
 		Symbol *symbol = left->symbol;
 
 		switch (op) {
 		case '=': break;
-		case ASSIGN_MUL: getMult(left, right); break;
-		case ASSIGN_DIV: getDiv(left, right); break;
-		case ASSIGN_REM: getRem(left, right); break;
-		case ASSIGN_ADD: getAdd(left, right); break;
-		case ASSIGN_SUB: getSub(left, right); break;
-		case ASSIGN_SHL: getShl(left, right); break;
-		case ASSIGN_ASHR: getAshr(left, right); break;
-		case ASSIGN_LSHR: getLshr(left, right); break;
-		case ASSIGN_ROL: getRol(left, right); break;
-		case ASSIGN_ROR: getRor(left, right); break;
-		case ASSIGN_AND: getBitwiseAnd(left, right); break;
-		case ASSIGN_XOR: getBitwiseXor(left, right); break;
-		case ASSIGN_OR: getBitwiseOr(left, right); break;
-		case ASSIGN_BAND: getBooleanAnd(left, right); break;
-		case ASSIGN_BXOR: getBooleanXor(left, right); break;
-		case ASSIGN_BOR: getBooleanOr(left, right); break;
+		case ASSIGN_MUL: getMult(cog, left, right); break;
+		case ASSIGN_DIV: getDiv(cog, left, right); break;
+		case ASSIGN_REM: getRem(cog, left, right); break;
+		case ASSIGN_ADD: getAdd(cog, left, right); break;
+		case ASSIGN_SUB: getSub(cog, left, right); break;
+		case ASSIGN_SHL: getShl(cog, left, right); break;
+		case ASSIGN_ASHR: getAshr(cog, left, right); break;
+		case ASSIGN_LSHR: getLshr(cog, left, right); break;
+		case ASSIGN_ROL: getRol(cog, left, right); break;
+		case ASSIGN_ROR: getRor(cog, left, right); break;
+		case ASSIGN_AND: getBitwiseAnd(cog, left, right); break;
+		case ASSIGN_XOR: getBitwiseXor(cog, left, right); break;
+		case ASSIGN_OR: getBitwiseOr(cog, left, right); break;
+		case ASSIGN_BAND: getBooleanAnd(cog, left, right); break;
+		case ASSIGN_BXOR: getBooleanXor(cog, left, right); break;
+		case ASSIGN_BOR: getBooleanOr(cog, left, right); break;
 		}
 
-		unaryTypecheck(left, symbol->type);
-		symbol->setValue(left->value);
+		unaryTypecheck(cog, left, symbol->type);
+		cog.getScope()->setValue(symbol, left->value);
 		left->value->setName(symbol->name);
-
-		if (left)
-			delete left;
-		if (right)
-			delete right;
 	} else {
 		error() << "here" << endl;
-		if (left)
-			delete left;
-		if (right)
-			delete right;
 		// something is broken
 	}
 }
 
-Info *variableDeclarationName(char *name, Info *expr)
+Info *variableDeclarationName(Compiler &cog, char *name, Info *expr)
 {
 	if (expr == NULL)
-		expr = new Info();
+		expr = cog.arena.createInfo();
 
 	expr->text = name;
-	delete name;
 	return expr;
 }
 
-void structureDefinition(char *name)
+void structureDefinition(Compiler &cog, char *name)
 {
 	cog.getStructure(name, cog.getScope()->symbols);
-	cog.getScope()->symbols.clear();
-
-	cog.scopes.pop_back();
-	cog.scopes.push_back(Scope());
+	cog.resetScope();
+	cog.arena.clear();
 }
 
-Info *functionPrototype(Info *retType, char *name)
+/**
+ * The type of the function called name that returns retType and takes the
+ * symbols of the current scope, the same Function callFunction looks for.
+ */
+static Function *getFunctionType(Compiler &cog, Info *retType, char *name)
 {
-	Scope *scope = cog.getScope();
-
-	Typename voidType;
-	voidType.setPrimType(Type::getVoidTy(cog.context), PrimType::Void);
+	std::vector<Declaration> args;
+	for (auto symbol = cog.getScope()->symbols.begin(); symbol != cog.getScope()->symbols.end(); symbol++)
+		args.push_back(Declaration(symbol->type, symbol->name));
 
-	BaseType *fType = cog.getFunction(retType->type, voidType, name, scope->symbols);
-	delete retType;
-
-	std::string mangled = fType->getName(false);
+	return (Function*)cog.getType(new Function(retType->type, cog.getType(new Void(cog)), name, args));
+}
 
-	Function *func = cog.module->getFunction(mangled.c_str());
-	if (func == NULL)
-		func = Function::Create((llvm::FunctionType*)fType->llvmType, Function::ExternalLinkage, mangled.c_str(), cog.module);
+// the function already declared with exactly type, NULL if there is none
+static llvm::Function *findFunction(Compiler &cog, Function *type)
+{
+	std::vector<Overload> *overloads = cog.getOverloads(cog.intern(type->typeName));
+	for (int i = 0; overloads != NULL && i < (int)overloads->size(); i++)
+		if ((*overloads)[i].type == type)
+			return (*overloads)[i].value;
+	return NULL;
+}
 
-	scope->symbols.clear();
-	
-	Info *result = new Info();
-	result->type.base = fType;
-	return result;
+// the name of functions of type in the module, "(void)main" for main
+static std::string getMangledName(Function *type)
+{
+	return "(" + type->thisType->name() + ")" + type->typeName;
 }
 
-void functionDeclaration(Info *retType, char *name)
+Info *functionPrototype(Compiler &cog, Info *retType, char *name)
 {
-	Scope *scope = cog.getScope();
+	if (retType == NULL) {
+		error() << "undefined return type of '" << name << "'." << endl;
+		cog.resetScope();
+		return NULL;
+	}
 
-	Typename voidType;
-	voidType.setPrimType(Type::getVoidTy(cog.context), PrimType::Void);
+	Function *fType = getFunctionType(cog, retType, name);
 
-	BaseType *fType = cog.getFunction(retType->type, voidType, name, scope->symbols);
-	delete retType;
+	llvm::Function *func = findFunction(cog, fType);
+	if (func == NULL) {
+		func = llvm::Function::Create((llvm::FunctionType*)fType->llvmType, llvm::Function::ExternalLinkage, getMangledName(fType), cog.module);
+		cog.declareFunction(fType, func);
+	}
 
-	std::string mangled = fType->getName(false);
+	cog.resetScope();
 	
-	Function *func = cog.module->getFunction(mangled.c_str());
-	if (func == NULL)
-		func = Function::Create((llvm::FunctionType*)fType->llvmType, Function::ExternalLinkage, mangled.c_str(), cog.module);
-	else if (!func->empty()) {
-		error() << "function redefined.\n";
-		int i = -1;
-		while (func != NULL) {
-			++i;
-			func = cog.module->getFunction((mangled + "_" + char('a' + i)).c_str());
-		}
+	Info *result = cog.arena.createInfo();
+	result->type = fType;
+	return result;
+}
 
-		func = Function::Create((llvm::FunctionType*)fType->llvmType, Function::ExternalLinkage, (mangled + "_" + char('a' + i)).c_str(), cog.module);
+void functionDeclaration(Compiler &cog, Info *retType, char *name)
+{
+	// functionPrototype already reported it, and the body isn't generated
+	if (retType == NULL) {
+		cog.resetScope();
+		cog.arena.clear();
+		cog.currFn = NULL;
+		return;
 	}
 
-	int i = 0;
-	for (auto &arg : func->args()) {
-		arg.setName(scope->symbols[i].name);
-		scope->symbols[i].setValue(&arg);
-		++i;
+	Scope *scope = cog.getScope();
+	Function *fType = getFunctionType(cog, retType, name);
+
+	llvm::Function *func = findFunction(cog, fType);
+	if (func == NULL) {
+		func = llvm::Function::Create((llvm::FunctionType*)fType->llvmType, llvm::Function::ExternalLinkage, getMangledName(fType), cog.module);
+		cog.declareFunction(fType, func);
+	} else if (!func->empty()) {
+		// the first body stays, the module gives this one a name of its own
+		error() << "function redefined.\n";
+		func = llvm::Function::Create((llvm::FunctionType*)fType->llvmType, llvm::Function::ExternalLinkage, getMangledName(fType), cog.module);
 	}
 
+	// closed by functionDefinition or asmFunctionDefinition
+	cog.trace.begin("Function", func->getName());
 	cog.currFn = fType;
 	BasicBlock *body = BasicBlock::Create(cog.context, "entry", func, 0);
-	scope->blocks.push_back(body);
-	scope->curr = scope->blocks.begin();
+	scope->setBlock(body);
 	cog.builder.SetInsertPoint(body);
+
+	auto symbol = scope->symbols.begin();
+	for (auto &arg : func->args()) {
+		arg.setName(symbol->name);
+		scope->setValue(&(*symbol), &arg);
+		++symbol;
+	}
 }
 
-void functionDefinition()
+void functionDefinition(Compiler &cog)
 {
-	cog.scopes.pop_back();
-	cog.scopes.push_back(Scope());
+	cog.trace.end();
+	cog.resetScope();
+	cog.arena.clear();
 	cog.currFn = NULL;
 }
 
-void returnValue(Info *value)
+void returnValue(Compiler &cog, Info *value)
 {
 	if (value) {
 		if (cog.currFn != NULL) {
-			unaryTypecheck(value, cog.currFn->retType);
+			unaryTypecheck(cog, value, cog.currFn->retType);
 			cog.builder.CreateRet(value->value);
 		} else {
 			error() << "return outside of function" << endl;
 		}
-
-		delete value;
 	} else {
 		error() << "here" << endl;
 	}
 }
 
-void returnVoid()
+void returnVoid(Compiler &cog)
 {
-	if (cog.currFn->retType.prim == NULL || cog.currFn->retType.prim->kind != PrimType::Void) {	
-		error() << "unable to cast 'void' to '" << cog.currFn->retType.getName() << "'." << endl;
+	if (!cog.currFn->retType->is<Void>()) {
+		error() << "unable to cast 'void' to '" << cog.currFn->retType->name() << "'." << endl;
 	}
 
 	cog.builder.CreateRetVoid();
 }
 
-void callFunction(char *txt, Info *argList)
+void callFunction(Compiler &cog, char *txt, Info *argList)
 {
-	std::vector<std::pair<Typename, llvm::Value*> > args;
+	std::vector<std::pair<Type*, llvm::Value*> > args;
 	Info *curr = argList;
 	while (curr != NULL) {
-		args.push_back(std::pair<Typename, llvm::Value*>(curr->type, curr->value));
+		args.push_back(std::pair<Type*, llvm::Value*>(curr->type, curr->value));
 		curr = curr->next;
 	}
 
-	Typename thisType;
-	thisType.setPrimType(Type::getVoidTy(cog.context), PrimType::Void);
-	std::string name = txt;
+	Type *thisType = cog.getType(new Void(cog));
 
+	// only the overloads sharing this name are candidates
 	int targetDist = -1;
-	std::vector<BaseType*> targets;
-	for (auto type = cog.types.begin(); type != cog.types.end(); type++) {
+	std::vector<Overload*> targets;
+	std::vector<Overload> *overloads = cog.getOverloads(txt);
+	for (int j = 0; overloads != NULL && j < (int)overloads->size(); j++) {
+		Overload *overload = &(*overloads)[j];
 		int castDist = 0;
-		
-		if (type->args.size() != args.size()
-		 || type->thisType != thisType
-		 || type->name != name)
+
+		if (overload->type->args.size() != args.size()
+		 || overload->type->thisType != thisType)
 			castDist = -1;
 
-		int tempDist = 0;
-		for (int i = 0; i < (int)args.size() && castDist > 0; i++) {
-			if (type->args[i].type != args[i].first) {
-				tempDist = implicitCastDistance(type->args[i].type, args[i].first);
-				if (tempDist < 0)
-					castDist = -1;
-				else
-					castDist += tempDist;
-			}
+		for (int i = 0; i < (int)args.size() && castDist >= 0; i++) {
+			int tempDist = cog.getCastDistance(args[i].first, overload->type->args[i].type);
+			if (tempDist < 0)
+				castDist = -1;
+			else
+				castDist += tempDist;
 		}
 
 		if (castDist >= 0 && (targetDist < 0 || castDist < targetDist)) {
 			targetDist = castDist;
 			targets.clear();
-			targets.push_back(&(*type));
+			targets.push_back(overload);
 		} else if (targetDist >= 0 && castDist == targetDist) {
-			targets.push_back(&(*type));
+			targets.push_back(overload);
 		}
 	}
 
 	if (targets.size() != 1) {
+		std::ostream &err = error();
 		if (targets.size() == 0)
-			error() << "undefined reference to ";
+			err << "undefined reference to ";
 		else
-			error() << "ambiguous reference to ";
+			err << "ambiguous reference to ";
 
-		error() << name << "(";
+		err << txt << "(";
 		for (int i = 0; i < (int)args.size(); i++) {
 			if (i != 0)
-				error() << ", ";
-			error() << args[i].first.getName();
+				err << ", ";
+			err << args[i].first->name();
 		}
-		error() << ")" << endl;
+		err << ")" << endl;
 	}
 	else {
 		std::vector<Value*> argValues;
 		for (int i = 0; i < (int)args.size(); i++) {
-			if (targets[0]->args[i].type != args[i].first) {
-				argValues.push_back(castType(args[i].second, args[i].first, targets[0]->args[i].type));
+			if (targets[0]->type->args[i].type != args[i].first) {
+				argValues.push_back(castType(cog, args[i].second, args[i].first, targets[0]->type->args[i].type));
 			} else {
 				argValues.push_back(args[i].second);
 			}
 		}
 
-		std::string mangled_name = targets[0]->getName(false);
-		cog.builder.CreateCall(cog.module->getFunction(mangled_name.c_str()), argValues);
+		cog.builder.CreateCall(targets[0]->value, argValues);
 	}
-
-	if (argList != NULL)
-		delete argList;
 }
 
-void ifCondition(Info *cond)
+void ifCondition(Compiler &cog, Info *cond)
 {
 	Function *func = cog.builder.GetInsertBlock()->getParent();
 	
@@ -655,7 +712,7 @@ void ifCondition(Info *cond)
 	cog.getScope()->appendBlock(thenBlock);
 	cog.getScope()->appendBlock(elseBlock);
 
-	unaryTypecheck(cond, Typename::getBool());
+	unaryTypecheck(cog, cond, Typename::getBool());
 
 	cog.builder.CreateCondBr(cond->value, thenBlock, elseBlock);
 	cog.getScope()->popBlock();
@@ -663,14 +720,14 @@ void ifCondition(Info *cond)
 	cog.builder.SetInsertPoint(cog.getScope()->getBlock());
 }
 
-void elseifCondition()
+void elseifCondition(Compiler &cog)
 {
 	cog.popScope();
 	cog.getScope()->nextBlock();	
 	cog.builder.SetInsertPoint(cog.getScope()->getBlock());
 }
 
-void elseCondition()
+void elseCondition(Compiler &cog)
 {
 	cog.popScope();
 	cog.getScope()->nextBlock();
@@ -678,40 +735,63 @@ void elseCondition()
 	cog.builder.SetInsertPoint(cog.getScope()->getBlock());
 }
 
-void ifStatement()
+void ifStatement(Compiler &cog)
 {
+	TraceTotal total(cog.trace, "PHI construction (us)");
 	Function *func = cog.builder.GetInsertBlock()->getParent();
 	
 	cog.popScope();
 	Scope *scope = cog.getScope();
-	// if this block has an else statement we can't use the remaining else block
-	if (std::next(scope->curr) == scope->blocks.end()) {
-		BasicBlock *mergeBlock = BasicBlock::Create(cog.context, "merge", func);
-		scope->appendBlock(mergeBlock);
-	}
-	
-	scope->nextBlock();
-	cog.builder.SetInsertPoint(scope->getBlock());
-
-	std::vector<llvm::PHINode*> phi;
-	phi.reserve(scope->symbols.size());
-	for (int i = 0; i < (int)scope->symbols.size(); i++) {
-		phi.push_back(cog.builder.CreatePHI(scope->symbols[i].type.getLlvm(), scope->blocks.size()-1));
-		phi.back()->setName(scope->symbols[i].name + "_");
-		scope->symbols[i].values.back() = phi.back();
+
+	// Without an else statement the else block is also reached straight from
+	// the condition, so it can't double as the merge block.
+	BasicBlock *mergeBlock = BasicBlock::Create(cog.context, "merge", func);
+	scope->appendBlock(mergeBlock);
+	scope->curr = std::prev(scope->blocks.end());
+	scope->load();
+	cog.builder.SetInsertPoint(mergeBlock);
+
+	// only the symbols that some branch rebound can differ at the merge
+	std::vector<Symbol*> changed;
+	std::unordered_set<Symbol*> seen;
+	for (auto branch = scope->blocks.begin(); branch != scope->curr; branch++)
+		for (int i = 0; i < (int)branch->changed.size(); i++)
+			if (seen.insert(branch->changed[i]).second)
+				changed.push_back(branch->changed[i]);
+
+	std::vector<Value*> merged;
+	merged.reserve(changed.size());
+	for (int i = 0; i < (int)changed.size(); i++) {
+		Value *same = scope->getValue(scope->blocks.front(), changed[i]);
+		bool differs = false;
+		for (auto branch = scope->blocks.begin(); branch != scope->curr && !differs; branch++)
+			differs = scope->getValue(*branch, changed[i]) != same;
+
+		if (!differs) {
+			merged.push_back(same);
+			continue;
+		}
+
+		PHINode *phi = cog.builder.CreatePHI(changed[i]->type->llvmType, scope->blocks.size()-1);
+		phi->setName(changed[i]->name + "_");
+		for (auto branch = scope->blocks.begin(); branch != scope->curr; branch++)
+			phi->addIncoming(scope->getValue(*branch, changed[i]), branch->block);
+		merged.push_back(phi);
+		cog.trace.count("PHIs");
 	}
 
 	while (scope->blocks.size() > 1) {
-		cog.builder.SetInsertPoint(scope->blocks.front());
-		cog.builder.CreateBr(scope->getBlock());
-		for (int i = 0; i < (int)scope->symbols.size(); i++)
-			phi[i]->addIncoming(scope->symbols[i].values.front(), scope->blocks.front());
+		cog.builder.SetInsertPoint(scope->blocks.front().block);
+		cog.builder.CreateBr(mergeBlock);
 		scope->dropBlock();
 	}
-	cog.builder.SetInsertPoint(scope->getBlock());
+
+	for (int i = 0; i < (int)changed.size(); i++)
+		scope->setValue(changed[i], merged[i]);
+	cog.builder.SetInsertPoint(mergeBlock);
 }
 
-void whileKeyword()
+void whileKeyword(Compiler &cog)
 {
 	Function *func = cog.builder.GetInsertBlock()->getParent();
 	BasicBlock *fromBlock = cog.getScope()->getBlock();
@@ -723,16 +803,11 @@ void whileKeyword()
 	cog.getScope()->popBlock();
 	cog.builder.SetInsertPoint(cog.getScope()->getBlock());
 
-	Scope *scope = cog.getScope();
-	for (int i = 0; i < (int)scope->symbols.size(); i++) {
-		PHINode *value = cog.builder.CreatePHI(scope->symbols[i].type.getLlvm(), scope->blocks.size()-1);
-		value->addIncoming(scope->symbols[i].getValue(), fromBlock);
-		value->setName(scope->symbols[i].name + "_");
-		scope->symbols[i].setValue(value);
-	}
+	// the header gets its PHIs as the loop uses each symbol, see useSymbol
+	cog.loops.push_back(Loop(cog.getScope(), condBlock, fromBlock));
 }
 
-void whileCondition(Info *cond)
+void whileCondition(Compiler &cog, Info *cond)
 {
 	Function *func = cog.builder.GetInsertBlock()->getParent();
 	
@@ -741,7 +816,7 @@ void whileCondition(Info *cond)
 	cog.getScope()->appendBlock(thenBlock);
 	cog.getScope()->appendBlock(elseBlock);
 
-	unaryTypecheck(cond, Typename::getBool());
+	unaryTypecheck(cog, cond, Typename::getBool());
 
 	cog.builder.CreateCondBr(cond->value, thenBlock, elseBlock);
 	cog.getScope()->nextBlock();
@@ -749,105 +824,110 @@ void whileCondition(Info *cond)
 	cog.builder.SetInsertPoint(cog.getScope()->getBlock());
 }
 
-void whileStatement()
+void whileStatement(Compiler &cog)
 {
-	Scope *prev = &cog.scopes[cog.scopes.size()-2];
-	Scope *curr = cog.getScope();
-	for (int i = 0; i < (int)prev->symbols.size(); i++) {
-		((PHINode*)prev->symbols[i].getValue())->addIncoming(curr->symbols[i].getValue(), curr->getBlock());
-		curr->symbols[i].setValue(prev->symbols[i].getValue());
-	}
+	TraceTotal total(cog.trace, "PHI construction (us)");
+	std::vector<std::pair<Symbol*, PHINode*> > phis;
+	phis.swap(cog.loops.back().phis);
+	BasicBlock *header = cog.loops.back().header;
+	cog.loops.pop_back();
+
+	// seal the header now that the back edge is known
+	BasicBlock *latch = cog.getScope()->getBlock();
+	for (int i = 0; i < (int)phis.size(); i++)
+		phis[i].second->addIncoming(phis[i].first->getValue(), latch);
 
 	cog.popScope();
-	cog.builder.CreateBr(cog.getScope()->blocks.front());
+	cog.builder.CreateBr(header);
 	cog.getScope()->nextBlock();
 	cog.builder.SetInsertPoint(cog.getScope()->getBlock());
 
 	while (cog.getScope()->blocks.size() > 1)
 		cog.getScope()->dropBlock();
+
+	// a symbol the loop only read keeps its value from before the loop
+	for (int i = 0; i < (int)phis.size(); i++)
+		removeTrivialPhi(cog, phis[i].first, phis[i].second);
 }
 
-Info *infoList(Info *lst, Info *elem)
+Info *infoList(Compiler &cog, Info *lst, Info *elem)
 {
 	if (lst) {
-		Info *curr = lst;
-		while (curr->next != NULL)
-			curr = curr->next;
+		// lst->last caches the tail so that building a list stays linear
+		if (lst->last == NULL)
+			for (lst->last = lst; lst->last->next != NULL; lst->last = lst->last->next);
 
-		curr->next = elem;
+		lst->last->next = elem;
+		while (lst->last->next != NULL)
+			lst->last = lst->last->next;
 		return lst;
 	} else
 		return elem;
 }
 
-Info *asmRegister(char *txt)
+Info *asmRegister(Compiler &cog, char *txt)
 {
-	Info *result = new Info();
+	Info *result = cog.arena.createInfo();
 	result->text = txt;
-	delete txt;
 	return result;
 }
 
-Info *asmConstant(char *txt)
+Info *asmConstant(Compiler &cog, char *txt)
 {
-	Info *result = new Info();
+	Info *result = cog.arena.createInfo();
 	if (txt[0] == '$')
 		result->text = std::string("$") + txt;
 	else
 		result->text = txt;
-	delete txt;
 	return result;
 }
 
-Info *asmFunction(char *txt, Info *args)
+Info *asmFunction(Compiler &cog, char *txt, Info *args)
 {
-	Info *result = new Info();
+	Info *result = cog.arena.createInfo();
 	result->text = txt;
 	result->next = args;
-	delete txt;
 	return result;
 }
 
-void asmFunctionDefinition()
+void asmFunctionDefinition(Compiler &cog)
 {
-	returnVoid();
-	cog.scopes.pop_back();
-	cog.scopes.push_back(Scope());
+	returnVoid(cog);
+	cog.trace.end();
+	cog.resetScope();
+	cog.arena.clear();
 }
 
-Info *asmMemoryArg(char *seg, char *cnst, Info *args)
+Info *asmMemoryArg(Compiler &cog, char *seg, char *cnst, Info *args)
 {
-	Info *result = new Info();
+	Info *result = cog.arena.createInfo();
 	if (seg) {
 		result->text += seg;
-		delete seg;
 	}
 
 	if (cnst) {
 		if (result->text.size() > 0)
 			result->text += ":";
 		result->text += cnst;
-		delete cnst;
 	}
 
 	result->args = args;
 	return result;
 }
 
-Info *asmAddress(Info *base, Info *offset, char *scale)
+Info *asmAddress(Compiler &cog, Info *base, Info *offset, char *scale)
 {
 	Info *result = NULL;
 	if (scale) {
-		result = new Info();
+		result = cog.arena.createInfo();
 		result->text = scale;
-		delete scale;
 	}
 
 	if (offset) {
 		offset->next = result;
 		result = offset;
 	} else if (result) {
-		offset = new Info();
+		offset = cog.arena.createInfo();
 		offset->next = result;
 		result = offset;
 	}
@@ -856,7 +936,7 @@ Info *asmAddress(Info *base, Info *offset, char *scale)
 		base->next = result;
 		result = base;
 	} else if (result) {
-		base = new Info();
+		base = cog.arena.createInfo();
 		base->next = result;
 		result = base;
 	}
@@ -864,28 +944,26 @@ Info *asmAddress(Info *base, Info *offset, char *scale)
 	return result;
 }
 
-Info *asmInstruction(char *instr, Info *args)
+Info *asmInstruction(Compiler &cog, char *instr, Info *args)
 {
-	Info *result = new Info();
+	Info *result = cog.arena.createInfo();
 	result->text = instr;
 	result->args = args;
-	delete instr;
 	return result;
 }
 
-Info *asmStatement(char *label, Info *instr)
+Info *asmStatement(Compiler &cog, char *label, Info *instr)
 {
 	Info *result = instr;
 	if (label) {
-		result = new Info();
+		result = cog.arena.createInfo();
 		result->args = instr;
 		result->text = label;
-		delete label;
 	}
 	return result;
 }
 
-void asmBlock(Info *stmts)
+void asmBlock(Compiler &cog, Info *stmts)
 {
 	std::vector<Symbol*> outs;
 	std::vector<Type*> outTypes;
@@ -1023,9 +1101,7 @@ void asmBlock(Info *stmts)
 	Value *ret = cog.builder.CreateCall(asmIns, inValues);
 
 	for (int i = 0; i < (int)outs.size(); i++)
-		outs[i]->setValue(ret);
-
-	delete stmts;
+		cog.getScope()->setValue(outs[i], ret);
 }
 
 }
@@ -2,57 +2,63 @@
 
 #include "Info.h"
 
+#include <llvm/ADT/APInt.h>
+
 namespace Cog
 {
 
-Info *getTypename(int token, char *txt);
-Info *getStaticArrayTypename(Info *name, Info *size);
-Info *getDynamicArrayTypename(Info *name);
-Info *getPointerTypename(Info *name);
+struct Compiler;
+
+llvm::APInt APInt_pow(llvm::APInt base, unsigned int exp);
+
+Info *getTypename(Compiler &cog, int token, char *txt);
+Info *getStaticArrayTypename(Compiler &cog, Info *name, Info *size);
+Info *getDynamicArrayTypename(Compiler &cog, Info *name);
+Info *getPointerTypename(Compiler &cog, Info *name);
 
-Info *getConstant(int token, char *txt);
-Info *getIdentifier(char *txt);
+Info *getConstant(Compiler &cog, int token, char *txt);
+Info *getIdentifier(Compiler &cog, char *txt);
 
-Info *unaryOperator(int op, Info *arg);
-Info *binaryOperator(Info *left, int op, Info *right);
+Info *unaryOperator(Compiler &cog, int op, Info *arg);
+Info *binaryOperator(Compiler &cog, Info *left, int op, Info *right);
 
-void declareSymbol(Info *type, char *name);
-void declareSymbols(Info *type, Info *names);
-void assignSymbol(Info *left, int op, Info *right);
+void declareSymbol(Compiler &cog, Info *type, char *name);
+void declareSymbols(Compiler &cog, Info *type, Info *names);
+void assignSymbol(Compiler &cog, Info *left, int op, Info *right);
 
-Info *variableDeclarationName(char *name, Info *expr);
+Info *variableDeclarationName(Compiler &cog, char *name, Info *expr);
 
-void structureDefinition(char *name);
+void structureDefinition(Compiler &cog, char *name);
 
-Info *functionPrototype(Info *retType, char *name);
-void functionDeclaration(Info *retType, char *name); 
-void functionDefinition();
-void returnValue(Info *value);
-void returnVoid();
+Info *functionPrototype(Compiler &cog, Info *retType, char *name);
+void functionDeclaration(Compiler &cog, Info *retType, char *name); 
+void functionDefinition(Compiler &cog);
+void returnValue(Compiler &cog, Info *value);
+void returnVoid(Compiler &cog);
 
-void callFunction(char *txt, Info *argList);
+void callFunction(Compiler &cog, char *txt, Info *argList);
 
-void ifCondition(Info *cond);
-void elseifCondition();
-void elseCondition();
-void ifStatement();
+void ifCondition(Compiler &cog, Info *cond);
+void elseifCondition(Compiler &cog);
+void elseCondition(Compiler &cog);
+void ifStatement(Compiler &cog);
 
-void whileKeyword();
-void whileCondition(Info *cond);
-void whileStatement();
+void whileKeyword(Compiler &cog);
+void whileCondition(Compiler &cog, Info *cond);
+void whileStatement(Compiler &cog);
 
-Info *infoList(Info *lst, Info *elem);
+Info *infoList(Compiler &cog, Info *lst, Info *elem);
 
-Info *asmRegister(char *txt);
-Info *asmConstant(char *txt);
-Info *asmIdentifier(char *txt);
-Info *asmFunction(char *txt, Info *args);
-void asmFunctionDefinition();
-Info *asmMemoryArg(char *seg, char *cnst, Info *args);
-Info *asmAddress(Info *base, Info *offset, char *scale);
-Info *asmInstruction(char *instr, Info *args);
-Info *asmStatement(char *label, Info *instr);
-void asmBlock(Info *instrs);
+Info *asmRegister(Compiler &cog, char *txt);
+Info *asmConstant(Compiler &cog, char *txt);
+Info *asmIdentifier(Compiler &cog, char *txt);
+Info *asmFunction(Compiler &cog, char *txt, Info *args);
+void asmFunctionDefinition(Compiler &cog);
+Info *asmMemoryArg(Compiler &cog, char *seg, char *cnst, Info *args);
+Info *asmAddress(Compiler &cog, Info *base, Info *offset, char *scale);
+Info *asmInstruction(Compiler &cog, char *instr, Info *args);
+Info *asmStatement(Compiler &cog, char *label, Info *instr);
+void asmBlock(Compiler &cog, Info *instrs);
 
 
 }
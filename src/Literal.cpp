@@ -0,0 +1,297 @@
+#include "Literal.h"
+#include "Compiler.h"
+
+#include <llvm/ADT/APFloat.h>
+#include <algorithm>
+
+namespace Cog
+{
+
+Literal::Literal() : mantissa(1, 0)
+{
+	exponent = 0;
+}
+
+Literal::Literal(const llvm::APInt &value, int exponent, bool isSigned)
+{
+	// make room for the sign bit of unsigned values
+	if (isSigned)
+		mantissa = value;
+	else
+		mantissa = value.zext(value.getBitWidth() + 1);
+	this->exponent = exponent;
+	normalize();
+}
+
+Literal::~Literal()
+{
+}
+
+/**
+ * Move trailing zero bits into the exponent and drop redundant sign bits, so
+ * that every value has exactly one representation.
+ */
+void Literal::normalize()
+{
+	if (mantissa.isNullValue()) {
+		mantissa = llvm::APInt(1, 0);
+		exponent = 0;
+		return;
+	}
+
+	unsigned shift = mantissa.countTrailingZeros();
+	mantissa = mantissa.ashr(shift);
+	exponent += shift;
+	mantissa = mantissa.sextOrTrunc(mantissa.getMinSignedBits());
+}
+
+bool Literal::isZero() const
+{
+	return mantissa.isNullValue();
+}
+
+bool Literal::isNegative() const
+{
+	return mantissa.isNegative();
+}
+
+bool Literal::isInteger() const
+{
+	return isZero() || exponent >= 0;
+}
+
+/**
+ * Give both literals the smaller of the two exponents and the same width,
+ * with one bit to spare for a carry.
+ */
+static void align(Literal &a, Literal &b)
+{
+	int exponent = std::min(a.exponent, b.exponent);
+	unsigned width = std::max(a.mantissa.getBitWidth() + (a.exponent - exponent),
+	                          b.mantissa.getBitWidth() + (b.exponent - exponent)) + 1;
+
+	a.mantissa = a.mantissa.sext(width).shl(a.exponent - exponent);
+	b.mantissa = b.mantissa.sext(width).shl(b.exponent - exponent);
+	a.exponent = exponent;
+	b.exponent = exponent;
+}
+
+int Literal::compare(const Literal &other) const
+{
+	Literal a = *this, b = other;
+	align(a, b);
+	if (a.mantissa.slt(b.mantissa))
+		return -1;
+	else if (a.mantissa.sgt(b.mantissa))
+		return 1;
+	return 0;
+}
+
+Literal Literal::neg() const
+{
+	Literal result = *this;
+	result.mantissa = -mantissa.sext(mantissa.getBitWidth() + 1);
+	result.normalize();
+	return result;
+}
+
+Literal Literal::add(const Literal &other) const
+{
+	Literal a = *this, b = other;
+	align(a, b);
+	a.mantissa += b.mantissa;
+	a.normalize();
+	return a;
+}
+
+Literal Literal::sub(const Literal &other) const
+{
+	Literal a = *this, b = other;
+	align(a, b);
+	a.mantissa -= b.mantissa;
+	a.normalize();
+	return a;
+}
+
+Literal Literal::mul(const Literal &other) const
+{
+	unsigned width = mantissa.getBitWidth() + other.mantissa.getBitWidth();
+
+	Literal result;
+	result.mantissa = mantissa.sext(width) * other.mantissa.sext(width);
+	result.exponent = exponent + other.exponent;
+	result.normalize();
+	return result;
+}
+
+/**
+ * Both mantissas are odd after normalize, so the quotient is exact when the
+ * divisor's mantissa divides the dividend's. Otherwise the dividend is widened
+ * by divisionPrecision bits and the quotient truncated. Returns false on a
+ * division by zero.
+ */
+bool Literal::div(const Literal &other, Literal &result) const
+{
+	if (other.isZero())
+		return false;
+
+	unsigned width = std::max(mantissa.getBitWidth(), other.mantissa.getBitWidth()) + 1;
+	llvm::APInt dividend = mantissa.sext(width);
+	llvm::APInt divisor = other.mantissa.sext(width);
+
+	int extra = 0;
+	if (!dividend.srem(divisor).isNullValue()) {
+		extra = other.mantissa.getBitWidth() + divisionPrecision;
+		width += extra;
+		dividend = dividend.sext(width).shl(extra);
+		divisor = divisor.sext(width);
+	}
+
+	result.mantissa = dividend.sdiv(divisor);
+	result.exponent = exponent - other.exponent - extra;
+	result.normalize();
+	return true;
+}
+
+/**
+ * The remainder of the quotient truncated to an integer, with the sign of the
+ * dividend like the srem instruction. Returns false on a division by zero.
+ */
+bool Literal::rem(const Literal &other, Literal &result) const
+{
+	if (other.isZero())
+		return false;
+
+	Literal a = *this, b = other;
+	align(a, b);
+	result.mantissa = a.mantissa.srem(b.mantissa);
+	result.exponent = a.exponent;
+	result.normalize();
+	return true;
+}
+
+/**
+ * Only defined for integers, where ~x is -x-1.
+ */
+Literal Literal::bitwiseNot() const
+{
+	Literal one(llvm::APInt(2, 1), 0, true);
+	return neg().sub(one);
+}
+
+Literal Literal::bitwiseAnd(const Literal &other) const
+{
+	Literal a = *this, b = other;
+	align(a, b);
+	a.mantissa &= b.mantissa;
+	a.normalize();
+	return a;
+}
+
+Literal Literal::bitwiseOr(const Literal &other) const
+{
+	Literal a = *this, b = other;
+	align(a, b);
+	a.mantissa |= b.mantissa;
+	a.normalize();
+	return a;
+}
+
+Literal Literal::bitwiseXor(const Literal &other) const
+{
+	Literal a = *this, b = other;
+	align(a, b);
+	a.mantissa ^= b.mantissa;
+	a.normalize();
+	return a;
+}
+
+/**
+ * Multiply by 2^distance. Shifting right keeps the bits that a shift
+ * instruction would drop.
+ */
+Literal Literal::shift(int distance) const
+{
+	Literal result = *this;
+	if (!isZero())
+		result.exponent += distance;
+	return result;
+}
+
+/**
+ * Round toward negative infinity to a multiple of 2^exponent, which is what
+ * an arithmetic shift right does to the bits below the last one it keeps.
+ */
+Literal Literal::floor(int exponent) const
+{
+	if (isZero() || this->exponent >= exponent)
+		return *this;
+
+	Literal result;
+	result.mantissa = mantissa.ashr(std::min(exponent - this->exponent, (int)mantissa.getBitWidth() - 1));
+	result.exponent = exponent;
+	result.normalize();
+	return result;
+}
+
+/**
+ * The narrowest type that holds this value exactly, the same type getConstant
+ * gives to a constant with this value.
+ */
+Type *Literal::getType(Compiler &cog) const
+{
+	if (isNegative())
+		return cog.getType(new Fixed(cog, true, mantissa.getBitWidth(), exponent));
+	else
+		return cog.getType(new Fixed(cog, false, std::max(mantissa.getActiveBits(), 1u), exponent));
+}
+
+static const llvm::fltSemantics &getSemantics(int sigwidth)
+{
+	switch (sigwidth) {
+	case 11: return llvm::APFloat::IEEEhalf();
+	case 24: return llvm::APFloat::IEEEsingle();
+	case 64: return llvm::APFloat::x87DoubleExtended();
+	case 113: return llvm::APFloat::IEEEquad();
+	default: return llvm::APFloat::IEEEdouble();
+	}
+}
+
+/**
+ * Round the value to type. This is the only place the value of a constant
+ * expression loses precision. Fixed point types truncate toward zero like
+ * castType does and wrap on overflow, floating point types round to nearest.
+ */
+llvm::Constant *Literal::materialize(const Type *type) const
+{
+	llvm::Type *llvmType = type->llvmType;
+
+	if (type->is<Boolean>())
+		return llvm::ConstantInt::get(llvmType, isZero() ? 0 : 1);
+
+	if (type->is<Float>()) {
+		llvm::APFloat result(getSemantics(type->get<Float>()->sigwidth));
+		result.convertFromAPInt(mantissa, true, llvm::APFloat::rmNearestTiesToEven);
+		result = llvm::scalbn(result, exponent, llvm::APFloat::rmNearestTiesToEven);
+		return llvm::ConstantFP::get(llvmType->getContext(), result);
+	}
+
+	const Fixed *fixed = type->get<Fixed>();
+	llvm::APInt value = mantissa;
+	int shift = exponent - fixed->exponent;
+	if (shift > 0) {
+		value = value.sext(value.getBitWidth() + shift).shl(shift);
+	} else if (shift < 0) {
+		unsigned distance = std::min((unsigned)-shift, value.getBitWidth() - 1);
+		llvm::APInt truncated = value.ashr(distance);
+		if (value.isNegative() && (unsigned)-shift < value.getBitWidth() && truncated.shl(distance) != value)
+			++truncated;
+		else if (value.isNegative() && (unsigned)-shift >= value.getBitWidth())
+			truncated = 0;
+		value = truncated;
+	}
+
+	return llvm::ConstantInt::get(llvmType, value.sextOrTrunc(fixed->bitwidth));
+}
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Type.h"
+
+#include <llvm/ADT/APInt.h>
+#include <llvm/IR/Constants.h>
+
+namespace Cog
+{
+
+/**
+ * The exact value of a constant expression, mantissa * 2^exponent. The
+ * mantissa is two's complement and grows as needed, so folding never
+ * overflows or rounds, with the exception of divisions whose quotient has no
+ * finite binary expansion. Those keep divisionPrecision extra bits.
+ */
+struct Literal
+{
+	Literal();
+	Literal(const llvm::APInt &value, int exponent, bool isSigned);
+	~Literal();
+
+	llvm::APInt mantissa;
+	int exponent;
+
+	static const int divisionPrecision = 64;
+
+	void normalize();
+
+	bool isZero() const;
+	bool isNegative() const;
+	bool isInteger() const;
+	int compare(const Literal &other) const;
+
+	Literal neg() const;
+	Literal add(const Literal &other) const;
+	Literal sub(const Literal &other) const;
+	Literal mul(const Literal &other) const;
+	bool div(const Literal &other, Literal &result) const;
+	bool rem(const Literal &other, Literal &result) const;
+
+	Literal bitwiseNot() const;
+	Literal bitwiseAnd(const Literal &other) const;
+	Literal bitwiseOr(const Literal &other) const;
+	Literal bitwiseXor(const Literal &other) const;
+	Literal shift(int distance) const;
+	Literal floor(int exponent) const;
+
+	Type *getType(Compiler &cog) const;
+	llvm::Constant *materialize(const Type *type) const;
+};
+
+}
@@ -0,0 +1,715 @@
+#include "Lsp.h"
+#include "Json.h"
+#include "Compiler.h"
+#include "Parser.y.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace std;
+
+namespace Cog
+{
+
+/**
+ * An error in an open document. The line is where its block was when it was
+ * parsed, see LspBlock::parsedLine. column is -1 for the errors found while
+ * generating, which only know their line.
+ */
+struct LspDiagnostic
+{
+	LspDiagnostic(int line, int column, const string &message)
+	{
+		this->line = line;
+		this->column = column;
+		this->message = message;
+	}
+
+	int line;
+	int column;
+	string message;
+};
+
+/**
+ * One top level declaration of an open document, see splitBlocks. A block
+ * whose text didn't change keeps its node, function and errors from the last
+ * update, only its line moves.
+ */
+struct LspBlock
+{
+	LspBlock()
+	{
+		line = 0;
+		column = 0;
+		parsedLine = 0;
+		node = -1;
+		nodeCount = 0;
+		function = NULL;
+	}
+
+	string text;
+	// where text starts in the document
+	int line;
+	int column;
+	// the line text started at when node was parsed, which the lines of the
+	// nodes and the errors are relative to
+	int parsedLine;
+	// the top level node, -1 if text has a syntax error
+	int node;
+	// how many nodes parsing text added to the ast
+	size_t nodeCount;
+	// the part of text the declarations depend on, the signature of a
+	// function and all of anything else
+	string declaration;
+	// the function the body was last generated into
+	llvm::Function *function;
+
+	vector<LspDiagnostic> syntax;
+	vector<LspDiagnostic> declared;
+	vector<LspDiagnostic> defined;
+};
+
+/**
+ * A document the client has open, with the compiler that holds the types,
+ * functions and syntax of its blocks between edits.
+ */
+struct LspDocument
+{
+	LspDocument()
+	{
+		cog = NULL;
+	}
+
+	~LspDocument()
+	{
+		delete cog;
+	}
+
+	string uri;
+	string path;
+	string text;
+	Compiler *cog;
+	vector<LspBlock> blocks;
+	// the errors that aren't in any block, such as an unreadable import
+	vector<LspDiagnostic> diagnostics;
+};
+
+static int countLines(const string &text)
+{
+	int count = 0;
+	for (size_t i = 0; i < text.size(); i++)
+		count += text[i] == '\n';
+	return count;
+}
+
+static void addBlock(const string &text, size_t start, size_t end, int line, int column, vector<LspBlock> &blocks)
+{
+	LspBlock block;
+	block.text = text.substr(start, end-start);
+	block.line = line;
+	block.column = column;
+
+	size_t brace = block.text.find('{');
+	bool function = brace != string::npos && block.text.compare(0, 6, "struct") != 0;
+	block.declaration = function ? block.text.substr(0, brace) : block.text;
+	blocks.push_back(block);
+}
+
+/**
+ * Split text into its top level blocks without parsing it. A block starts at
+ * its first token and ends at the '}' that closes its outermost brace, or at
+ * a ';' outside of any braces. Comments and strings are skipped, so a brace
+ * in them doesn't count.
+ */
+static void splitBlocks(const string &text, vector<LspBlock> &blocks)
+{
+	int line = 0;
+	size_t lineStart = 0;
+	int depth = 0;
+	size_t start = string::npos;
+	int startLine = 0;
+	int startColumn = 0;
+	for (size_t i = 0; i < text.size(); i++) {
+		char c = text[i];
+		if (c == '\n') {
+			line++;
+			lineStart = i+1;
+			continue;
+		}
+
+		if (c == '/' && i+1 < text.size() && text[i+1] == '/') {
+			size_t end = text.find('\n', i);
+			i = (end == string::npos ? text.size() : end) - 1;
+			continue;
+		}
+		if (c == '/' && i+1 < text.size() && text[i+1] == '*') {
+			size_t end = text.find("*/", i+2);
+			end = end == string::npos ? text.size() : end+2;
+			for (; i < end; i++)
+				if (text[i] == '\n') {
+					line++;
+					lineStart = i+1;
+				}
+			i--;
+			continue;
+		}
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f')
+			continue;
+
+		if (start == string::npos) {
+			start = i;
+			startLine = line;
+			startColumn = i - lineStart;
+		}
+
+		if (c == '"') {
+			for (i++; i < text.size() && text[i] != '"'; i++) {
+				if (text[i] == '\\')
+					i++;
+				else if (text[i] == '\n') {
+					line++;
+					lineStart = i+1;
+				}
+			}
+		} else if (c == '{')
+			depth++;
+		else if ((c == '}' && depth > 0 && --depth == 0) || (c == ';' && depth == 0)) {
+			addBlock(text, start, i+1, startLine, startColumn, blocks);
+			start = string::npos;
+		}
+	}
+
+	// an unfinished block runs to the end
+	if (start != string::npos)
+		addBlock(text, start, text.size(), startLine, startColumn, blocks);
+}
+
+// move what cog reported since its log was last cleared into errors
+static void collect(Compiler &cog, vector<LspDiagnostic> &errors, bool columns)
+{
+	string log = cog.log.str();
+	for (size_t i = 0; i < cog.diagnostics.size(); i++) {
+		const Diagnostic &diagnostic = cog.diagnostics[i];
+		size_t end = log.find('\n', diagnostic.offset);
+		string message = log.substr(diagnostic.offset, end == string::npos ? string::npos : end - diagnostic.offset);
+		errors.push_back(LspDiagnostic(diagnostic.line, columns ? diagnostic.column : -1, message));
+	}
+	cog.log.str("");
+	cog.diagnostics.clear();
+}
+
+/**
+ * Parse the text of block on its own into cog.ast, starting at its line and
+ * column so that its nodes and errors have their place in the document.
+ */
+static void parseBlock(Compiler &cog, LspBlock &block)
+{
+	block.parsedLine = block.line;
+	block.node = -1;
+	block.syntax.clear();
+	cog.log.str("");
+	cog.diagnostics.clear();
+
+	size_t count = cog.ast.blocks.size();
+	size_t nodes = cog.ast.nodes.size();
+	if (openText(cog, block.text.data(), block.text.size())) {
+		cog.line = block.line;
+		cog.column = block.column;
+		int result = yyparse(cog.scanner, cog);
+		closeSource(cog);
+		if (result == 0 && cog.ast.blocks.size() == count+1)
+			block.node = cog.ast.blocks.back();
+	}
+	cog.ast.blocks.resize(count);
+	block.nodeCount = cog.ast.nodes.size() - nodes;
+	collect(cog, block.syntax, true);
+}
+
+/**
+ * Generate the body of block again, into the function it defined before if
+ * it did, whose old body is dropped first. Only the IR of the body is built,
+ * which is what checks its types; it is never optimized or compiled.
+ */
+static void defineBody(Compiler &cog, LspBlock &block)
+{
+	block.defined.clear();
+	if (block.function != NULL)
+		block.function->deleteBody();
+	block.function = NULL;
+	if (block.node < 0 || cog.ast.get(block.node).kind != FUNCTION_NODE)
+		return;
+
+	cog.log.str("");
+	cog.diagnostics.clear();
+	block.function = defineFunction(cog, cog.ast, block.node);
+	collect(cog, block.defined, false);
+}
+
+/**
+ * Throw the compiler of doc away and check all of doc again, which is needed
+ * whenever a declaration changed since the types and signatures the bodies
+ * were generated against are no longer right.
+ */
+static void rebuild(LspDocument &doc)
+{
+	delete doc.cog;
+	doc.cog = new Compiler();
+	Compiler &cog = *doc.cog;
+	cog.loadFile(doc.path);
+	doc.diagnostics.clear();
+
+	for (auto block = doc.blocks.begin(); block != doc.blocks.end(); block++) {
+		parseBlock(cog, *block);
+		block->declared.clear();
+		block->function = NULL;
+		if (block->node >= 0)
+			cog.ast.blocks.push_back(block->node);
+	}
+
+	if (!cog.loadImports()) {
+		string log = cog.log.str();
+		doc.diagnostics.push_back(LspDiagnostic(0, -1, log.substr(0, log.find('\n'))));
+		cog.imports.clear();
+	}
+	cog.log.str("");
+	cog.diagnostics.clear();
+
+	vector<int> bodies;
+	vector<LspDiagnostic> declared;
+	declareBlocks(cog, cog.ast, bodies);
+	collect(cog, declared, false);
+	for (size_t i = 0; i < declared.size(); i++) {
+		LspBlock *owner = NULL;
+		for (auto block = doc.blocks.begin(); block != doc.blocks.end() && owner == NULL; block++)
+			if (declared[i].line >= block->line && declared[i].line <= block->line + countLines(block->text))
+				owner = &*block;
+		(owner != NULL ? owner->declared : doc.diagnostics).push_back(declared[i]);
+	}
+
+	for (auto block = doc.blocks.begin(); block != doc.blocks.end(); block++)
+		defineBody(cog, *block);
+}
+
+/**
+ * Bring the blocks of doc up to date with its text. Blocks whose text didn't
+ * change are kept as they are. As long as no declaration changed, only the
+ * blocks that did are parsed again and only their bodies generated, against
+ * the types and symbols the compiler already has. Otherwise everything is.
+ */
+static void update(LspDocument &doc)
+{
+	vector<LspBlock> blocks;
+	splitBlocks(doc.text, blocks);
+	if (doc.cog == NULL) {
+		doc.blocks.swap(blocks);
+		rebuild(doc);
+		return;
+	}
+
+	// the old blocks by text, the first one last
+	unordered_map<string, vector<int> > unchanged;
+	for (int i = (int)doc.blocks.size()-1; i >= 0; i--)
+		unchanged[doc.blocks[i].text].push_back(i);
+
+	vector<bool> reused(doc.blocks.size(), false);
+	vector<int> changed;
+	for (int i = 0; i < (int)blocks.size(); i++) {
+		auto found = unchanged.find(blocks[i].text);
+		if (found == unchanged.end() || found->second.empty()) {
+			changed.push_back(i);
+			continue;
+		}
+
+		int old = found->second.back();
+		found->second.pop_back();
+		reused[old] = true;
+		int line = blocks[i].line;
+		int column = blocks[i].column;
+		blocks[i] = doc.blocks[old];
+		blocks[i].line = line;
+		blocks[i].column = column;
+	}
+
+	bool declarationsChanged = blocks.size() != doc.blocks.size();
+	for (size_t i = 0; i < blocks.size() && !declarationsChanged; i++)
+		declarationsChanged = blocks[i].declaration != doc.blocks[i].declaration;
+	if (declarationsChanged) {
+		doc.blocks.swap(blocks);
+		rebuild(doc);
+		return;
+	}
+
+	// a changed body takes over the function of an old body it replaced
+	unordered_map<string, vector<llvm::Function*> > functions;
+	for (size_t i = 0; i < doc.blocks.size(); i++)
+		if (!reused[i] && doc.blocks[i].function != NULL)
+			functions[doc.blocks[i].declaration].push_back(doc.blocks[i].function);
+
+	Compiler &cog = *doc.cog;
+	for (size_t i = 0; i < changed.size(); i++) {
+		LspBlock &block = blocks[changed[i]];
+		vector<llvm::Function*> &replaced = functions[block.declaration];
+		if (!replaced.empty()) {
+			block.function = replaced.back();
+			replaced.pop_back();
+		}
+		parseBlock(cog, block);
+		defineBody(cog, block);
+	}
+	doc.blocks.swap(blocks);
+
+	// the nodes of the blocks that were replaced stay in the ast, so once
+	// they outnumber the ones still used everything is parsed again
+	size_t live = 0;
+	for (size_t i = 0; i < doc.blocks.size(); i++)
+		live += doc.blocks[i].nodeCount;
+	if (cog.ast.nodes.size() > 2*live + 4096)
+		rebuild(doc);
+}
+
+// whether the character of a position counts bytes, which the client can
+// agree to in initialize, or else UTF-16 code units as the protocol says
+static bool utf8Positions = false;
+
+/**
+ * The offset of the position character in the line of text that runs from
+ * start to end, which is past the end of the line if it is too long.
+ */
+static size_t getByteOffset(const string &text, size_t start, size_t end, int character)
+{
+	if (utf8Positions)
+		return min(start + max(character, 0), end);
+
+	size_t offset = start;
+	for (int units = 0; offset < end && units < character;) {
+		unsigned char c = text[offset];
+		int length = c < 0xC0 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+		// what needs four bytes in UTF-8 is a surrogate pair in UTF-16
+		units += length == 4 ? 2 : 1;
+		offset = min(offset + length, end);
+	}
+	return offset;
+}
+
+// the position character of offset in the line of text that starts at start
+static int getCharacter(const string &text, size_t start, size_t offset)
+{
+	if (utf8Positions)
+		return offset - start;
+
+	int units = 0;
+	for (size_t i = start; i < offset; i++) {
+		unsigned char c = text[i];
+		if (c < 0x80 || c >= 0xC0)
+			units += c >= 0xF0 ? 2 : 1;
+	}
+	return units;
+}
+
+// the type the TYPE node at index names, as it is written
+static string getTypeName(const Ast &ast, int index)
+{
+	const Node &node = ast.get(index);
+	switch (node.kind) {
+	case DYNAMIC_ARRAY_TYPE_NODE:
+		return getTypeName(ast, ast.child(node, 0)) + "[]";
+	case STATIC_ARRAY_TYPE_NODE:
+		return getTypeName(ast, ast.child(node, 0)) + "[" + ast.get(ast.child(node, 1)).text + "]";
+	case POINTER_TYPE_NODE:
+		return getTypeName(ast, ast.child(node, 0)) + "*";
+	}
+	return node.text != NULL ? node.text : "";
+}
+
+static string getSignature(const Ast &ast, int index)
+{
+	const Node &proto = ast.get(index);
+	const Node &args = ast.get(ast.child(proto, 1));
+	string result = getTypeName(ast, ast.child(proto, 0)) + " " + proto.text + "(";
+	for (int i = 0; i < args.count; i++) {
+		const Node &arg = ast.get(ast.child(args, i));
+		result += (i > 0 ? ", " : "") + getTypeName(ast, ast.child(arg, 0)) + " " + arg.text;
+	}
+	return result + ")";
+}
+
+/**
+ * Find the argument or variable called name that the tree at index declares
+ * last before line.
+ */
+static void findLocal(const Ast &ast, int index, const char *name, int line, string &found, int &foundLine)
+{
+	const Node &node = ast.get(index);
+	if (node.kind == ARGUMENT_NODE && strcmp(node.text, name) == 0) {
+		found = getTypeName(ast, ast.child(node, 0)) + " " + name;
+		return;
+	}
+	if (node.kind == DECLARATION_NODE && node.line <= line && node.line >= foundLine) {
+		const Node &names = ast.get(ast.child(node, 1));
+		for (int i = 0; i < names.count; i++)
+			if (strcmp(ast.get(ast.child(names, i)).text, name) == 0) {
+				found = getTypeName(ast, ast.child(node, 0)) + " " + name;
+				foundLine = node.line;
+			}
+		return;
+	}
+
+	for (int i = 0; i < node.count; i++)
+		if (ast.child(node, i) >= 0)
+			findLocal(ast, ast.child(node, i), name, line, found, foundLine);
+}
+
+/**
+ * What the identifier at line and character of doc refers to: the type of a
+ * local variable or argument, the signatures of a function or a structure.
+ */
+static string getHover(const LspDocument &doc, int line, int character)
+{
+	size_t start = 0;
+	for (int i = 0; i < line && start != string::npos; i++) {
+		start = doc.text.find('\n', start);
+		start = start == string::npos ? start : start+1;
+	}
+	if (start == string::npos)
+		return "";
+
+	size_t end = doc.text.find('\n', start);
+	end = end == string::npos ? doc.text.size() : end;
+	string text = doc.text.substr(start, end-start);
+	size_t first = getByteOffset(doc.text, start, end, character) - start;
+	size_t last = first;
+	while (first > 0 && (isalnum(text[first-1]) || text[first-1] == '_'))
+		first--;
+	while (last < text.size() && (isalnum(text[last]) || text[last] == '_'))
+		last++;
+	if (first == last || isdigit(text[first]))
+		return "";
+
+	string name = text.substr(first, last-first);
+	const Ast &ast = doc.cog->ast;
+	for (auto block = doc.blocks.begin(); block != doc.blocks.end(); block++) {
+		if (line < block->line || line > block->line + countLines(block->text))
+			continue;
+		if (block->node < 0 || ast.get(block->node).kind != FUNCTION_NODE)
+			break;
+
+		string found;
+		int foundLine = -1;
+		findLocal(ast, block->node, name.c_str(), line - block->line + block->parsedLine, found, foundLine);
+		if (found != "")
+			return found;
+		break;
+	}
+
+	string result;
+	unordered_set<string> seen;
+	for (auto block = doc.blocks.begin(); block != doc.blocks.end(); block++) {
+		if (block->node < 0)
+			continue;
+
+		const Node &node = ast.get(block->node);
+		string found;
+		if (node.kind == STRUCTURE_NODE && name == node.text)
+			found = "struct " + name;
+		else if (node.kind == PROTOTYPE_NODE && name == node.text)
+			found = getSignature(ast, block->node);
+		else if (node.kind == FUNCTION_NODE && name == ast.get(ast.child(node, 0)).text)
+			found = getSignature(ast, ast.child(node, 0));
+
+		if (found != "" && seen.insert(found).second)
+			result += (result != "" ? "\n" : "") + found;
+	}
+	return result;
+}
+
+static bool readMessage(string &body)
+{
+	size_t length = 0;
+	bool found = false;
+	char header[256];
+	while (true) {
+		if (fgets(header, sizeof(header), stdin) == NULL)
+			return false;
+		if (strcmp(header, "\r\n") == 0 || strcmp(header, "\n") == 0) {
+			if (found)
+				break;
+			continue;
+		}
+		if (strncasecmp(header, "Content-Length:", 15) == 0) {
+			length = strtoul(header+15, NULL, 10);
+			found = true;
+		}
+	}
+
+	body.resize(length);
+	return length == 0 || fread(&body[0], 1, length, stdin) == length;
+}
+
+static void writeMessage(const string &body)
+{
+	printf("Content-Length: %zu\r\n\r\n", body.size());
+	fwrite(body.data(), 1, body.size(), stdout);
+	fflush(stdout);
+}
+
+static void respond(const Json &id, const string &result)
+{
+	writeMessage("{\"jsonrpc\":\"2.0\",\"id\":" + id.write() + ",\"result\":" + result + "}");
+}
+
+static void respondError(const Json &id, int code, const string &message)
+{
+	writeMessage("{\"jsonrpc\":\"2.0\",\"id\":" + id.write() + ",\"error\":{\"code\":" + to_string(code) +
+		",\"message\":\"" + escapeJson(message) + "\"}}");
+}
+
+// a file:// uri as a path, anything else as it is
+static string getPath(const string &uri)
+{
+	if (uri.compare(0, 7, "file://") != 0)
+		return uri;
+
+	string path;
+	for (size_t i = 7; i < uri.size(); i++) {
+		if (uri[i] == '%' && i+2 < uri.size()) {
+			path += (char)strtol(uri.substr(i+1, 2).c_str(), NULL, 16);
+			i += 2;
+		} else
+			path += uri[i];
+	}
+	return path;
+}
+
+// the offset of position in text
+static size_t getOffset(const string &text, const Json &position)
+{
+	size_t offset = 0;
+	for (int i = 0; i < position["line"].asInt(); i++) {
+		size_t end = text.find('\n', offset);
+		if (end == string::npos)
+			return text.size();
+		offset = end+1;
+	}
+
+	size_t end = text.find('\n', offset);
+	end = end == string::npos ? text.size() : end;
+	return getByteOffset(text, offset, end, position["character"].asInt());
+}
+
+static void publish(const LspDocument &doc)
+{
+	vector<size_t> lines(1, 0);
+	for (size_t i = 0; i < doc.text.size(); i++)
+		if (doc.text[i] == '\n')
+			lines.push_back(i+1);
+
+	string items;
+	auto add = [&](const LspDiagnostic &diagnostic, int shift) {
+		int line = max(0, min(diagnostic.line + shift, (int)lines.size()-1));
+		size_t end = doc.text.find('\n', lines[line]);
+		int length = (end == string::npos ? doc.text.size() : end) - lines[line];
+		int column = max(0, min(diagnostic.column-1, length));
+
+		char range[128];
+		snprintf(range, sizeof(range), "{\"start\":{\"line\":%d,\"character\":%d},\"end\":{\"line\":%d,\"character\":%d}}",
+			line, getCharacter(doc.text, lines[line], lines[line] + column),
+			line, getCharacter(doc.text, lines[line], lines[line] + length));
+		items += (items != "" ? "," : "") + string("{\"range\":") + range +
+			",\"severity\":1,\"source\":\"cog\",\"message\":\"" + escapeJson(diagnostic.message) + "\"}";
+	};
+
+	for (auto diagnostic = doc.diagnostics.begin(); diagnostic != doc.diagnostics.end(); diagnostic++)
+		add(*diagnostic, 0);
+	for (auto block = doc.blocks.begin(); block != doc.blocks.end(); block++) {
+		int shift = block->line - block->parsedLine;
+		for (auto diagnostic = block->syntax.begin(); diagnostic != block->syntax.end(); diagnostic++)
+			add(*diagnostic, shift);
+		for (auto diagnostic = block->declared.begin(); diagnostic != block->declared.end(); diagnostic++)
+			add(*diagnostic, shift);
+		for (auto diagnostic = block->defined.begin(); diagnostic != block->defined.end(); diagnostic++)
+			add(*diagnostic, shift);
+	}
+
+	writeMessage("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":\"" +
+		escapeJson(doc.uri) + "\",\"diagnostics\":[" + items + "]}}");
+}
+
+/**
+ * Serve the language server protocol over stdin and stdout: diagnostics for
+ * every open document after each change and hover for identifiers. Edits
+ * come in as ranges and only the blocks they touch are checked again, see
+ * update. Nothing is ever compiled to machine code.
+ */
+int serveLsp()
+{
+	unordered_map<string, unique_ptr<LspDocument> > documents;
+	bool shutdown = false;
+	string body;
+	while (readMessage(body)) {
+		Json message;
+		if (!Json::parse(body, message)) {
+			respondError(Json(), -32700, "could not parse message");
+			continue;
+		}
+
+		const string &method = message["method"].string;
+		const Json &id = message["id"];
+		const Json &params = message["params"];
+		const string &uri = params["textDocument"]["uri"].string;
+		auto found = documents.find(uri);
+		LspDocument *doc = found != documents.end() ? found->second.get() : NULL;
+
+		if (method == "initialize") {
+			const Json &encodings = params["capabilities"]["general"]["positionEncodings"];
+			for (size_t i = 0; i < encodings.elements.size(); i++)
+				utf8Positions = utf8Positions || encodings[i].string == "utf-8";
+			respond(id, string("{\"capabilities\":{\"positionEncoding\":\"") + (utf8Positions ? "utf-8" : "utf-16") + "\","
+				"\"textDocumentSync\":{\"openClose\":true,\"change\":2},\"hoverProvider\":true},"
+				"\"serverInfo\":{\"name\":\"cog\",\"version\":\"" + escapeJson(compilerVersion) + "\"}}");
+		} else if (method == "shutdown") {
+			shutdown = true;
+			respond(id, "null");
+		} else if (method == "exit")
+			return shutdown ? 0 : 1;
+		else if (method == "textDocument/didOpen") {
+			doc = new LspDocument();
+			documents[uri].reset(doc);
+			doc->uri = uri;
+			doc->path = getPath(uri);
+			doc->text = params["textDocument"]["text"].string;
+			update(*doc);
+			publish(*doc);
+		} else if (method == "textDocument/didChange" && doc != NULL) {
+			const Json &changes = params["contentChanges"];
+			for (size_t i = 0; i < changes.elements.size(); i++) {
+				const Json &change = changes[i];
+				const Json &range = change["range"];
+				if (range.kind == NULL_JSON)
+					doc->text = change["text"].string;
+				else {
+					size_t start = getOffset(doc->text, range["start"]);
+					size_t end = max(start, getOffset(doc->text, range["end"]));
+					doc->text.replace(start, end-start, change["text"].string);
+				}
+			}
+			update(*doc);
+			publish(*doc);
+		} else if (method == "textDocument/didClose" && doc != NULL) {
+			writeMessage("{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\",\"params\":{\"uri\":\"" +
+				escapeJson(uri) + "\",\"diagnostics\":[]}}");
+			documents.erase(found);
+		} else if (method == "textDocument/hover") {
+			string hover = doc != NULL ? getHover(*doc, params["position"]["line"].asInt(), params["position"]["character"].asInt()) : "";
+			respond(id, hover == "" ? "null" : "{\"contents\":{\"kind\":\"plaintext\",\"value\":\"" + escapeJson(hover) + "\"}}");
+		} else if (id.kind != NULL_JSON && method != "")
+			respondError(id, -32601, "unknown method '" + method + "'");
+	}
+	return shutdown ? 0 : 1;
+}
+
+}
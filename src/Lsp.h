@@ -0,0 +1,9 @@
+#pragma once
+
+namespace Cog
+{
+
+// answers language server protocol messages on stdin until the client exits
+int serveLsp();
+
+}
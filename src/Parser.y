@@ -1,22 +1,26 @@
 %code requires {
-#include "Lang.h"
+#include "Ast.h"
+#include "Compiler.h"
+}
+%code provides {
+int yylex(YYSTYPE *yylval, void *scanner);
+void yyerror(void *scanner, Cog::Compiler &cog, const char *s);
 }
 %{
 #include "Parser.y.h"
 
-void yyerror(const char *s);
-int yylex(void);
-
-extern FILE* yyin;
-extern int line;
-extern int column;
-extern const char* str;
-
+// lexing is interleaved with parsing, so its time is summed up separately
+#define yylex(value, scanner) tracedLex(value, scanner, cog)
+int tracedLex(YYSTYPE *value, void *scanner, Cog::Compiler &cog);
 %}
 
+%define api.pure full
+%lex-param {void *scanner}
+%parse-param {void *scanner} {Cog::Compiler &cog}
+
 %token VOID_PRIMITIVE BOOL_PRIMITIVE INT_PRIMITIVE FLOAT_PRIMITIVE FIXED_PRIMITIVE
 %token IDENTIFIER HEX_CONSTANT DEC_CONSTANT BIN_CONSTANT BOOL_CONSTANT STRING_CONSTANT
-%token ASM STRUCT IF ELSE WHILE RETURN AND XOR OR NOT
+%token ASM STRUCT IMPORT IF ELSE WHILE RETURN AND XOR OR NOT
 %token LE GE NE EQ SHL ASHR LSHR ROL ROR
 %token ASM_REGISTER ASM_CONSTANT ASM_DIRECTIVE ASM_LABEL
 %token ASSIGN_MUL ASSIGN_DIV ASSIGN_REM ASSIGN_ADD ASSIGN_SUB ASSIGN_SHL ASSIGN_ASHR ASSIGN_LSHR ASSIGN_ROL ASSIGN_ROR ASSIGN_BAND ASSIGN_BXOR ASSIGN_BOR ASSIGN_AND ASSIGN_OR ASSIGN_XOR
@@ -25,7 +29,7 @@ extern const char* str;
 %union {
 	int token;
 	char *syntax;
-	Cog::Info *info;
+	int node;
 }
 
 %type<syntax> VOID_PRIMITIVE BOOL_PRIMITIVE INT_PRIMITIVE FLOAT_PRIMITIVE FIXED_PRIMITIVE IDENTIFIER HEX_CONSTANT DEC_CONSTANT BIN_CONSTANT BOOL_CONSTANT STRING_CONSTANT ASM_REGISTER ASM_CONSTANT ASM_DIRECTIVE ASM_LABEL
@@ -33,126 +37,122 @@ extern const char* str;
 %%
 
 program
-	: program block
-	| block
+	: program block { cog.ast.blocks.push_back($<node>2); }
+	| block { cog.ast.blocks.push_back($<node>1); }
 	;
 
 block
-	: structure_declaration
-	| function_prototype { delete $<info>1; }
+	: import_declaration
+	| structure_declaration
+	| function_prototype
 	| function_definition
 	;
 
+import_declaration
+	: IMPORT STRING_CONSTANT ';' { $<node>$ = cog.ast.create(Cog::IMPORT_NODE, $<syntax>2); }
+	;
+
 structure_declaration
-	: STRUCT IDENTIFIER '{' declaration_block '}' { Cog::structureDefinition($<syntax>2); }
-	| STRUCT IDENTIFIER '{' '}' { Cog::structureDefinition($<syntax>2); }
+	: STRUCT IDENTIFIER '{' declaration_block '}' { $<node>$ = cog.ast.create(Cog::STRUCTURE_NODE, { cog.ast.createList(Cog::BLOCK_NODE, $<node>4) }, $<syntax>2); }
+	| STRUCT IDENTIFIER '{' '}' { $<node>$ = cog.ast.create(Cog::STRUCTURE_NODE, { cog.ast.createList(Cog::BLOCK_NODE, -1) }, $<syntax>2); }
 	;
 
 function_definition
-	: function_declaration '{' statement_list '}' { Cog::functionDefinition(); }
-	| function_declaration asm_block { Cog::asmFunctionDefinition(); }
-	| function_declaration '{' '}' { Cog::functionDefinition(); }
+	: function_declaration '{' statement_list '}' { $<node>$ = cog.ast.create(Cog::FUNCTION_NODE, { $<node>1, cog.ast.createList(Cog::BLOCK_NODE, $<node>3) }); }
+	| function_declaration asm_block { $<node>$ = cog.ast.create(Cog::FUNCTION_NODE, { $<node>1, $<node>2 }); }
+	| function_declaration '{' '}' { $<node>$ = cog.ast.create(Cog::FUNCTION_NODE, { $<node>1, cog.ast.createList(Cog::BLOCK_NODE, -1) }); }
 	;
 
 function_prototype
-	: type_specifier IDENTIFIER '(' argument_declaration_list ')' ';' { $<info>$ = Cog::functionPrototype($<info>1, $<syntax>2); }
-	| type_specifier IDENTIFIER '(' ')' ';' { $<info>$ = Cog::functionPrototype($<info>1, $<syntax>2); }
+	: function_declaration ';' { $<node>$ = $<node>1; }
 	;
 
 function_declaration
-	: type_specifier IDENTIFIER '(' argument_declaration_list ')' { Cog::functionDeclaration($<info>1, $<syntax>2); }
-	| type_specifier IDENTIFIER '(' ')' { Cog::functionDeclaration($<info>1, $<syntax>2); }
+	: type_specifier IDENTIFIER '(' argument_declaration_list ')' { $<node>$ = cog.ast.create(Cog::PROTOTYPE_NODE, { $<node>1, cog.ast.createList(Cog::LIST_NODE, $<node>4) }, $<syntax>2); }
+	| type_specifier IDENTIFIER '(' ')' { $<node>$ = cog.ast.create(Cog::PROTOTYPE_NODE, { $<node>1, cog.ast.createList(Cog::LIST_NODE, -1) }, $<syntax>2); }
 	;
 
 statement_list
-	: statement_list primary_statement
-	| primary_statement
+	: statement_list primary_statement { $<node>$ = cog.ast.append($<node>1, $<node>2); }
+	| primary_statement { $<node>$ = cog.ast.append(-1, $<node>1); }
 	;
 
 primary_statement
-	: variable_declaration ';'
-	| assignment ';'
-	| asm_block
-	| call ';'
-	| ret ';'
-	| if_statement
-	| while_statement
+	: variable_declaration ';' { $<node>$ = $<node>1; }
+	| assignment ';' { $<node>$ = $<node>1; }
+	| asm_block { $<node>$ = $<node>1; }
+	| call ';' { $<node>$ = $<node>1; }
+	| ret ';' { $<node>$ = $<node>1; }
+	| if_statement { $<node>$ = $<node>1; }
+	| while_statement { $<node>$ = $<node>1; }
 	;
 
 statement_block
-	: '{' statement_list '}'
-	| primary_statement
+	: '{' statement_list '}' { $<node>$ = cog.ast.createList(Cog::BLOCK_NODE, $<node>2); }
+	| primary_statement { $<node>$ = cog.ast.create(Cog::BLOCK_NODE, { $<node>1 }); }
 	;
 
 while_statement
-	: while_condition statement_block { Cog::whileStatement(); }
-	;
-
-while_condition
-	: while_keyword '(' expression ')' { Cog::whileCondition($<info>3); }
-	;
-
-while_keyword
-	: WHILE { Cog::whileKeyword(); }
+	: WHILE '(' expression ')' statement_block { $<node>$ = cog.ast.create(Cog::WHILE_NODE, { $<node>3, $<node>5 }); }
 	;
 
 if_statement
-	: if_block else_condition statement_block { Cog::ifStatement(); }
-	| if_block { Cog::ifStatement(); }
+	: if_block else_condition statement_block { $<node>$ = cog.ast.createList(Cog::IF_NODE, cog.ast.append($<node>1, $<node>3)); }
+	| if_block { $<node>$ = cog.ast.createList(Cog::IF_NODE, $<node>1); }
 	;
 
 if_block
-	: if_block elseif_condition if_condition statement_block
-	| if_condition statement_block
+	: if_block elseif_condition if_condition statement_block { $<node>$ = cog.ast.append(cog.ast.append($<node>1, $<node>3), $<node>4); }
+	| if_condition statement_block { $<node>$ = cog.ast.append(cog.ast.append(-1, $<node>1), $<node>2); }
 	;
 
 if_condition
-	: IF '(' expression ')' { Cog::ifCondition($<info>3); }
+	: IF '(' expression ')' { $<node>$ = $<node>3; }
 	;
 
 elseif_condition
-	: ELSE { Cog::elseifCondition(); }
+	: ELSE
 	;
 
 else_condition
-	: ELSE { Cog::elseCondition(); }
+	: ELSE
 	;
 
 declaration_block
-	: declaration_block variable_declaration ';'
-	| variable_declaration ';'
+	: declaration_block variable_declaration ';' { $<node>$ = cog.ast.append($<node>1, $<node>2); }
+	| variable_declaration ';' { $<node>$ = cog.ast.append(-1, $<node>1); }
 	;
 
 argument_declaration_list
-	: argument_declaration_list ',' argument_declaration
-	| argument_declaration
+	: argument_declaration_list ',' argument_declaration { $<node>$ = cog.ast.append($<node>1, $<node>3); }
+	| argument_declaration { $<node>$ = cog.ast.append(-1, $<node>1); }
 	;
 
 argument_declaration
-	: type_specifier IDENTIFIER { Cog::declareSymbol($<info>1, $<syntax>2); }
+	: type_specifier IDENTIFIER { $<node>$ = cog.ast.create(Cog::ARGUMENT_NODE, { $<node>1 }, $<syntax>2); }
 	;
 
 variable_declaration
-	: type_specifier variable_declaration_name_list { Cog::declareSymbols($<info>1, $<info>2); }
+	: type_specifier variable_declaration_name_list { $<node>$ = cog.ast.create(Cog::DECLARATION_NODE, { $<node>1, cog.ast.createList(Cog::LIST_NODE, $<node>2) }); }
 	;
 
 type_list
-	: type_list ',' type_specifier { Cog::infoList($<info>1, $<info>3); }
-	| type_specifier { $<info>$ = $<info>1; }
+	: type_list ',' type_specifier { $<node>$ = cog.ast.append($<node>1, $<node>3); }
+	| type_specifier { $<node>$ = cog.ast.append(-1, $<node>1); }
 	;
 
 variable_declaration_name_list
-	: variable_declaration_name_list ',' variable_declaration_name { $<info>$ = Cog::infoList($<info>1, $<info>3); }
-	| variable_declaration_name { $<info>$ = $<info>1; }
+	: variable_declaration_name_list ',' variable_declaration_name { $<node>$ = cog.ast.append($<node>1, $<node>3); }
+	| variable_declaration_name { $<node>$ = cog.ast.append(-1, $<node>1); }
 	;
 
 variable_declaration_name
-	: IDENTIFIER '=' expression { $<info>$ = Cog::variableDeclarationName($<syntax>1, $<info>3); }
-	| IDENTIFIER { $<info>$ = Cog::variableDeclarationName($<syntax>1, NULL); }
+	: IDENTIFIER '=' expression { $<node>$ = cog.ast.create(Cog::NAME_NODE, { $<node>3 }, $<syntax>1); }
+	| IDENTIFIER { $<node>$ = cog.ast.create(Cog::NAME_NODE, $<syntax>1); }
 	;
 
 assignment
-	: instance assign_op expression { Cog::assignSymbol($<info>1, $<token>2, $<info>3); }
+	: instance assign_op expression { $<node>$ = cog.ast.create(Cog::ASSIGNMENT_NODE, { $<node>1, $<node>3 }, NULL, $<token>2); }
 	;
 
 assign_op
@@ -177,86 +177,86 @@ assign_op
 
 
 asm_block
-	: ASM '{' asm_statement_list '}' { Cog::asmBlock($<info>3); }
+	: ASM '{' asm_statement_list '}' { $<node>$ = cog.ast.create(Cog::ASM_NODE, { cog.ast.createList(Cog::LIST_NODE, $<node>3) }); }
 	;
 
 asm_statement_list
-	: asm_statement_list asm_statement { $<info>$ = Cog::infoList($<info>1, $<info>2); }
-	| asm_statement_list ';' asm_statement { $<info>$ = Cog::infoList($<info>1, $<info>3); }
-	| asm_statement { $<info>$ = $<info>1; }
+	: asm_statement_list asm_statement { $<node>$ = cog.ast.append($<node>1, $<node>2); }
+	| asm_statement_list ';' asm_statement { $<node>$ = cog.ast.append($<node>1, $<node>3); }
+	| asm_statement { $<node>$ = cog.ast.append(-1, $<node>1); }
 	;
 
 asm_statement
-	: ASM_LABEL asm_instruction { $<info>$ = asmStatement($<syntax>1, $<info>2); }
-	| asm_instruction { $<info>$ = $<info>1; }
+	: ASM_LABEL asm_instruction { $<node>$ = cog.ast.create(Cog::ASM_STATEMENT_NODE, { $<node>2 }, $<syntax>1); }
+	| asm_instruction { $<node>$ = $<node>1; }
 	;
 
 asm_instruction
-	: IDENTIFIER asm_argument_list	{ $<info>$ = Cog::asmInstruction($<syntax>1, $<info>2); }
-	| IDENTIFIER	{ $<info>$ = Cog::asmInstruction($<syntax>1, NULL); }
+	: IDENTIFIER asm_argument_list	{ $<node>$ = cog.ast.create(Cog::ASM_INSTRUCTION_NODE, { cog.ast.createList(Cog::LIST_NODE, $<node>2) }, $<syntax>1); }
+	| IDENTIFIER	{ $<node>$ = cog.ast.create(Cog::ASM_INSTRUCTION_NODE, { cog.ast.createList(Cog::LIST_NODE, -1) }, $<syntax>1); }
 	;
 
 asm_argument_list
-	: asm_argument_list ',' asm_argument { $<info>$ = Cog::infoList($<info>1, $<info>3); }
-	| asm_argument_list ',' asm_memory_arg { $<info>$ = Cog::infoList($<info>1, $<info>3); }
-	| asm_argument { $<info>$ = $<info>1; }
-	| asm_memory_arg { $<info>$ = $<info>1; }
+	: asm_argument_list ',' asm_argument { $<node>$ = cog.ast.append($<node>1, $<node>3); }
+	| asm_argument_list ',' asm_memory_arg { $<node>$ = cog.ast.append($<node>1, $<node>3); }
+	| asm_argument { $<node>$ = cog.ast.append(-1, $<node>1); }
+	| asm_memory_arg { $<node>$ = cog.ast.append(-1, $<node>1); }
 	;
 
 asm_memory_arg
-	: ASM_REGISTER ':' DEC_CONSTANT asm_address	{ $<info>$ = Cog::asmMemoryArg($<syntax>1, $<syntax>3, $<info>4); }
-	| DEC_CONSTANT asm_address									{ $<info>$ = Cog::asmMemoryArg(NULL, $<syntax>1, $<info>2); }
+	: ASM_REGISTER ':' DEC_CONSTANT asm_address	{ $<node>$ = cog.ast.create(Cog::ASM_MEMORY_NODE, { cog.ast.create(Cog::ASM_REGISTER_NODE, $<syntax>1), $<node>4 }, $<syntax>3); }
+	| DEC_CONSTANT asm_address									{ $<node>$ = cog.ast.create(Cog::ASM_MEMORY_NODE, { -1, $<node>2 }, $<syntax>1); }
 	;
 
 asm_address
-	: '(' asm_argument ',' asm_argument ',' DEC_CONSTANT ')'	{ $<info>$ = Cog::asmAddress($<info>2, $<info>4, $<syntax>6); }
-	| '(' asm_argument ',' asm_argument ')'										{ $<info>$ = Cog::asmAddress($<info>2, $<info>4, NULL); }
-	| '(' asm_argument ')'																		{ $<info>$ = Cog::asmAddress($<info>2, NULL, NULL); }
-	| '(' ')'																									{ $<info>$ = Cog::asmAddress(NULL, NULL, NULL); }
-	| '(' asm_argument ',' ',' DEC_CONSTANT ')'								{ $<info>$ = Cog::asmAddress($<info>2, NULL, $<syntax>5); }
-	| '(' ',' asm_argument ',' DEC_CONSTANT ')'								{ $<info>$ = Cog::asmAddress(NULL, $<info>3, $<syntax>5); }
-	| '(' ',' DEC_CONSTANT ')'																{ $<info>$ = Cog::asmAddress(NULL, $<info>3, NULL); }
+	: '(' asm_argument ',' asm_argument ',' DEC_CONSTANT ')'	{ $<node>$ = cog.ast.create(Cog::ASM_ADDRESS_NODE, { $<node>2, $<node>4 }, $<syntax>6); }
+	| '(' asm_argument ',' asm_argument ')'										{ $<node>$ = cog.ast.create(Cog::ASM_ADDRESS_NODE, { $<node>2, $<node>4 }); }
+	| '(' asm_argument ')'																		{ $<node>$ = cog.ast.create(Cog::ASM_ADDRESS_NODE, { $<node>2, -1 }); }
+	| '(' ')'																									{ $<node>$ = cog.ast.create(Cog::ASM_ADDRESS_NODE, { -1, -1 }); }
+	| '(' asm_argument ',' ',' DEC_CONSTANT ')'								{ $<node>$ = cog.ast.create(Cog::ASM_ADDRESS_NODE, { $<node>2, -1 }, $<syntax>5); }
+	| '(' ',' asm_argument ',' DEC_CONSTANT ')'								{ $<node>$ = cog.ast.create(Cog::ASM_ADDRESS_NODE, { -1, $<node>3 }, $<syntax>5); }
+	| '(' ',' DEC_CONSTANT ')'																{ $<node>$ = cog.ast.create(Cog::ASM_ADDRESS_NODE, { -1, -1 }, $<syntax>3); }
 	;
 
 asm_argument
-	: ASM_REGISTER	{ $<info>$ = Cog::asmRegister($<syntax>1); }
-	| ASM_CONSTANT	{ $<info>$ = Cog::asmConstant($<syntax>1); }
-	| IDENTIFIER	{ $<info>$ = Cog::getIdentifier($<syntax>1); }
-	| IDENTIFIER '(' type_list ')' { $<info>$ = Cog::asmFunction($<syntax>1, $<info>3); }
+	: ASM_REGISTER	{ $<node>$ = cog.ast.create(Cog::ASM_REGISTER_NODE, $<syntax>1); }
+	| ASM_CONSTANT	{ $<node>$ = cog.ast.create(Cog::ASM_CONSTANT_NODE, $<syntax>1); }
+	| IDENTIFIER	{ $<node>$ = cog.ast.create(Cog::IDENTIFIER_NODE, $<syntax>1); }
+	| IDENTIFIER '(' type_list ')' { $<node>$ = cog.ast.create(Cog::ASM_FUNCTION_NODE, { cog.ast.createList(Cog::LIST_NODE, $<node>3) }, $<syntax>1); }
 	;
 
 call
-	: IDENTIFIER '(' argument_list ')' { Cog::callFunction($<syntax>1, $<info>3); }
-	| IDENTIFIER '(' ')' { Cog::callFunction($<syntax>1, NULL); }
+	: IDENTIFIER '(' argument_list ')' { $<node>$ = cog.ast.create(Cog::CALL_NODE, { cog.ast.createList(Cog::LIST_NODE, $<node>3) }, $<syntax>1); }
+	| IDENTIFIER '(' ')' { $<node>$ = cog.ast.create(Cog::CALL_NODE, { cog.ast.createList(Cog::LIST_NODE, -1) }, $<syntax>1); }
 	;
 
 ret
-	: RETURN expression { Cog::returnValue($<info>2); }
-	| RETURN { Cog::returnVoid(); }
+	: RETURN expression { $<node>$ = cog.ast.create(Cog::RETURN_NODE, { $<node>2 }); }
+	| RETURN { $<node>$ = cog.ast.create(Cog::RETURN_NODE); }
 	;
 
 expression
-	: lOR_expression { $<info>$ = $<info>1; }
+	: lOR_expression { $<node>$ = $<node>1; }
 	;
 
 lOR_expression
-	: lOR_expression OR lXOR_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| lXOR_expression { $<info>$ = $<info>1; }
+	: lOR_expression OR lXOR_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, OR); }
+	| lXOR_expression { $<node>$ = $<node>1; }
 	;
 
 lXOR_expression
-	: lXOR_expression XOR lAND_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| lAND_expression { $<info>$ = $<info>1; }
+	: lXOR_expression XOR lAND_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, XOR); }
+	| lAND_expression { $<node>$ = $<node>1; }
 	;
 
 lAND_expression
-	: lAND_expression AND rel_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| rel_expression { $<info>$ = $<info>1; }
+	: lAND_expression AND rel_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, AND); }
+	| rel_expression { $<node>$ = $<node>1; }
 	;
 
 rel_expression
-	: rel_expression rel_operator bOR_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| bOR_expression { $<info>$ = $<info>1; }
+	: rel_expression rel_operator bOR_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, $<token>2); }
+	| bOR_expression { $<node>$ = $<node>1; }
 	;
 
 rel_operator
@@ -269,23 +269,23 @@ rel_operator
 	;
 
 bOR_expression
-	: bOR_expression '|' bXOR_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| bXOR_expression { $<info>$ = $<info>1; }
+	: bOR_expression '|' bXOR_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, '|'); }
+	| bXOR_expression { $<node>$ = $<node>1; }
 	;
 
 bXOR_expression
-	: bXOR_expression '^' bAND_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| bAND_expression { $<info>$ = $<info>1; }
+	: bXOR_expression '^' bAND_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, '^'); }
+	| bAND_expression { $<node>$ = $<node>1; }
 	;
 
 bAND_expression
-	: bAND_expression '&' shift_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| shift_expression { $<info>$ = $<info>1; }
+	: bAND_expression '&' shift_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, '&'); }
+	| shift_expression { $<node>$ = $<node>1; }
 	;
 
 shift_expression
-	: shift_expression shift_operator add_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| add_expression { $<info>$ = $<info>1; }
+	: shift_expression shift_operator add_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, $<token>2); }
+	| add_expression { $<node>$ = $<node>1; }
 	;
 
 shift_operator
@@ -297,8 +297,8 @@ shift_operator
 	;
 
 add_expression
-	: add_expression add_operator mult_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| mult_expression { $<info>$ = $<info>1; }
+	: add_expression add_operator mult_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, $<token>2); }
+	| mult_expression { $<node>$ = $<node>1; }
 	;
 
 add_operator
@@ -307,8 +307,8 @@ add_operator
 	;
 
 mult_expression
-	: mult_expression mult_operator unary_expression { $<info>$ = Cog::binaryOperator($<info>1, $<token>2, $<info>3); }
-	| unary_expression { $<info>$ = $<info>1; }
+	: mult_expression mult_operator unary_expression { $<node>$ = cog.ast.create(Cog::BINARY_NODE, { $<node>1, $<node>3 }, NULL, $<token>2); }
+	| unary_expression { $<node>$ = $<node>1; }
 	;
 
 mult_operator
@@ -318,8 +318,8 @@ mult_operator
 	;
 
 unary_expression
-	: unary_operator primary_expression { $<info>$ = Cog::unaryOperator($<token>1, $<info>2); }
-	| primary_expression { $<info>$ = $<info>1; }
+	: unary_operator primary_expression { $<node>$ = cog.ast.create(Cog::UNARY_NODE, { $<node>2 }, NULL, $<token>1); }
+	| primary_expression { $<node>$ = $<node>1; }
 	;
 
 unary_operator
@@ -329,54 +329,65 @@ unary_operator
 	;
 
 primary_expression
-	: constant						{ $<info>$ = $<info>1; }
-	| instance						{ $<info>$ = $<info>1; }
-	| '(' expression ')'	{ $<info>$ = $<info>2; }
+	: constant						{ $<node>$ = $<node>1; }
+	| instance						{ $<node>$ = $<node>1; }
+	| '(' expression ')'	{ $<node>$ = $<node>2; }
 	;
 
 argument_list
-	: argument_list ',' expression { $<info>$ = Cog::infoList($<info>1, $<info>3); }
-	| expression { $<info>$ = $<info>1; }
+	: argument_list ',' expression { $<node>$ = cog.ast.append($<node>1, $<node>3); }
+	| expression { $<node>$ = cog.ast.append(-1, $<node>1); }
 	;
 
 constant
-	: BOOL_CONSTANT	{ $<info>$ = Cog::getConstant(BOOL_CONSTANT, $<syntax>1); }
-	| DEC_CONSTANT	{ $<info>$ = Cog::getConstant(DEC_CONSTANT, $<syntax>1); }
-	| HEX_CONSTANT	{ $<info>$ = Cog::getConstant(HEX_CONSTANT, $<syntax>1); }
-	| BIN_CONSTANT	{ $<info>$ = Cog::getConstant(BIN_CONSTANT, $<syntax>1); }
-	| STRING_CONSTANT	{ $<info>$ = Cog::getConstant(STRING_CONSTANT, $<syntax>1); }
+	: BOOL_CONSTANT	{ $<node>$ = cog.ast.create(Cog::CONSTANT_NODE, $<syntax>1, BOOL_CONSTANT); }
+	| DEC_CONSTANT	{ $<node>$ = cog.ast.create(Cog::CONSTANT_NODE, $<syntax>1, DEC_CONSTANT); }
+	| HEX_CONSTANT	{ $<node>$ = cog.ast.create(Cog::CONSTANT_NODE, $<syntax>1, HEX_CONSTANT); }
+	| BIN_CONSTANT	{ $<node>$ = cog.ast.create(Cog::CONSTANT_NODE, $<syntax>1, BIN_CONSTANT); }
+	| STRING_CONSTANT	{ $<node>$ = cog.ast.create(Cog::CONSTANT_NODE, $<syntax>1, STRING_CONSTANT); }
 	;
 
 instance
-	: IDENTIFIER	{ $<info>$ = Cog::getIdentifier($<syntax>1); }
+	: IDENTIFIER	{ $<node>$ = cog.ast.create(Cog::IDENTIFIER_NODE, $<syntax>1); }
 	;
 
 type_specifier
-	: type_specifier '[' ']' { $<info>$ = Cog::getDynamicArrayTypename($<info>1); }
-	| type_specifier '[' constant ']' { $<info>$ = Cog::getStaticArrayTypename($<info>1, $<info>3); }
-	| type_specifier '*' { $<info>$ = Cog::getPointerTypename($<info>1); }
-	| VOID_PRIMITIVE { $<info>$ = Cog::getTypename(VOID_PRIMITIVE, $<syntax>1); }
-	| BOOL_PRIMITIVE { $<info>$ = Cog::getTypename(BOOL_PRIMITIVE, $<syntax>1); }
-	| INT_PRIMITIVE { $<info>$ = Cog::getTypename(INT_PRIMITIVE, $<syntax>1); }
-	| FLOAT_PRIMITIVE { $<info>$ = Cog::getTypename(FLOAT_PRIMITIVE, $<syntax>1); }
-	| FIXED_PRIMITIVE { $<info>$ = Cog::getTypename(FIXED_PRIMITIVE, $<syntax>1); }
-	| IDENTIFIER { $<info>$ = Cog::getTypename(IDENTIFIER, $<syntax>1); }
+	: type_specifier '[' ']' { $<node>$ = cog.ast.create(Cog::DYNAMIC_ARRAY_TYPE_NODE, { $<node>1 }); }
+	| type_specifier '[' constant ']' { $<node>$ = cog.ast.create(Cog::STATIC_ARRAY_TYPE_NODE, { $<node>1, $<node>3 }); }
+	| type_specifier '*' { $<node>$ = cog.ast.create(Cog::POINTER_TYPE_NODE, { $<node>1 }); }
+	| VOID_PRIMITIVE { $<node>$ = cog.ast.create(Cog::TYPE_NODE, $<syntax>1, VOID_PRIMITIVE); }
+	| BOOL_PRIMITIVE { $<node>$ = cog.ast.create(Cog::TYPE_NODE, $<syntax>1, BOOL_PRIMITIVE); }
+	| INT_PRIMITIVE { $<node>$ = cog.ast.create(Cog::TYPE_NODE, $<syntax>1, INT_PRIMITIVE); }
+	| FLOAT_PRIMITIVE { $<node>$ = cog.ast.create(Cog::TYPE_NODE, $<syntax>1, FLOAT_PRIMITIVE); }
+	| FIXED_PRIMITIVE { $<node>$ = cog.ast.create(Cog::TYPE_NODE, $<syntax>1, FIXED_PRIMITIVE); }
+	| IDENTIFIER { $<node>$ = cog.ast.create(Cog::TYPE_NODE, $<syntax>1, IDENTIFIER); }
 	;
 
 %%
 
-void yyerror(const char *s) {
-	fprintf(stderr, "%d:%d: %s\n", line, column, s);
-	fprintf(stderr, "%s\n", str);
-	for (int i = 0; i < column-1; i++) {
-		if (str[i] <= ' ' || str[i] == 127)
-			fputc(str[i], stderr);
+int tracedLex(YYSTYPE *value, void *scanner, Cog::Compiler &cog)
+{
+	Cog::TraceTotal total(cog.trace, "lex time (us)");
+	cog.trace.count("tokens");
+	int token = (yylex)(value, scanner);
+	cog.ast.line = cog.line;
+	return token;
+}
+
+void yyerror(void *scanner, Cog::Compiler &cog, const char *s) {
+	cog.log << cog.line << ":" << cog.column << ": ";
+	cog.diagnostics.push_back(Cog::Diagnostic(cog.line, cog.column, cog.log.tellp()));
+	cog.log << s << std::endl;
+	cog.log << cog.str << std::endl;
+	for (int i = 0; i < cog.column-1; i++) {
+		if (cog.str[i] <= ' ' || cog.str[i] == 127)
+			cog.log << cog.str[i];
 		else
-			fputc(' ', stderr);
+			cog.log << ' ';
 	}
-	fputc('^', stderr);
-	for (const char *c = str+column+1; c; c++)
-		fputc('~', stderr);
-	fputc('\n', stderr);
+	cog.log << '^';
+	for (const char *c = cog.str+cog.column+1; *c && *c != '\n'; c++)
+		cog.log << '~';
+	cog.log << std::endl;
 }
 
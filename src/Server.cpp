@@ -0,0 +1,305 @@
+#include "Server.h"
+#include "Compiler.h"
+
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace Cog
+{
+
+/**
+ * Requests are the client's stdout and stderr, working directory, arguments
+ * and environment, every string sent as a length and its bytes. The response
+ * is the exit status of the driver.
+ */
+
+// $XDG_RUNTIME_DIR, or a directory in /tmp that serve makes private
+static string getPrivateDirectory()
+{
+	const char *runtime = getenv("XDG_RUNTIME_DIR");
+	if (runtime && runtime[0])
+		return runtime;
+	return "/tmp/cog-" + to_string(getuid());
+}
+
+string getSocketPath()
+{
+	const char *path = getenv("COG_SERVER");
+	if (path && path[0])
+		return path;
+	return getPrivateDirectory() + "/cog.sock";
+}
+
+/**
+ * Create directory if needed and check that only this user can enter it, so
+ * nobody else can put a socket of their own at the path clients connect to.
+ */
+static bool makePrivate(const string &directory)
+{
+	mkdir(directory.c_str(), 0700);
+
+	struct stat info;
+	return lstat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode)
+	    && info.st_uid == getuid() && (info.st_mode & 077) == 0;
+}
+
+// whether the other end of connection runs as this user
+static bool isSameUser(int connection)
+{
+	struct ucred peer;
+	socklen_t size = sizeof(peer);
+	return getsockopt(connection, SOL_SOCKET, SO_PEERCRED, &peer, &size) == 0 && peer.uid == getuid();
+}
+
+static bool sendAll(int fd, const void *data, size_t size)
+{
+	const char *curr = (const char*)data;
+	while (size > 0) {
+		ssize_t sent = send(fd, curr, size, MSG_NOSIGNAL);
+		if (sent <= 0)
+			return false;
+		curr += sent;
+		size -= sent;
+	}
+	return true;
+}
+
+static bool recvAll(int fd, void *data, size_t size)
+{
+	char *curr = (char*)data;
+	while (size > 0) {
+		ssize_t received = recv(fd, curr, size, 0);
+		if (received <= 0)
+			return false;
+		curr += received;
+		size -= received;
+	}
+	return true;
+}
+
+static bool sendString(int fd, const string &str)
+{
+	uint32_t size = str.size();
+	return sendAll(fd, &size, sizeof(size)) && sendAll(fd, str.data(), size);
+}
+
+static bool recvString(int fd, string &str)
+{
+	uint32_t size;
+	if (!recvAll(fd, &size, sizeof(size)))
+		return false;
+	str.resize(size);
+	return size == 0 || recvAll(fd, &str[0], size);
+}
+
+static bool sendStrings(int fd, char **strs)
+{
+	uint32_t count = 0;
+	while (strs[count])
+		++count;
+
+	if (!sendAll(fd, &count, sizeof(count)))
+		return false;
+	for (uint32_t i = 0; i < count; i++)
+		if (!sendString(fd, strs[i]))
+			return false;
+	return true;
+}
+
+static bool recvStrings(int fd, vector<string> &strs)
+{
+	uint32_t count;
+	if (!recvAll(fd, &count, sizeof(count)))
+		return false;
+
+	strs.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+		if (!recvString(fd, strs[i]))
+			return false;
+	return true;
+}
+
+static bool setAddress(const string &path, struct sockaddr_un &address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(address.sun_path))
+		return false;
+	strcpy(address.sun_path, path.c_str());
+	return true;
+}
+
+/**
+ * Serve a single request in a child of the server, which has the warm target
+ * registry of its parent and a working directory and output of its own.
+ */
+static void handle(int connection, Driver driver)
+{
+	if (!isSameUser(connection))
+		_exit(1);
+
+	int fds[2];
+	char control[CMSG_SPACE(sizeof(fds))];
+	char byte;
+	struct iovec data = { &byte, 1 };
+	struct msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &data;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	struct cmsghdr *header;
+	if (recvmsg(connection, &message, 0) != 1 || !(header = CMSG_FIRSTHDR(&message))
+	 || header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(fds)))
+		_exit(1);
+	memcpy(fds, CMSG_DATA(header), sizeof(fds));
+
+	string cwd;
+	vector<string> args, env;
+	if (!recvString(connection, cwd) || !recvStrings(connection, args) || !recvStrings(connection, env))
+		_exit(1);
+
+	vector<char*> argv;
+	for (size_t i = 0; i < args.size(); i++)
+		argv.push_back(&args[i][0]);
+	argv.push_back(NULL);
+
+	clearenv();
+	for (size_t i = 0; i < env.size(); i++)
+		putenv(&env[i][0]);
+
+	int32_t status = 1;
+	if (chdir(cwd.c_str()) == 0 && dup2(fds[0], 1) >= 0 && dup2(fds[1], 2) >= 0)
+		status = driver(args.size(), argv.data());
+
+	fflush(stdout);
+	fflush(stderr);
+	sendAll(connection, &status, sizeof(status));
+	_exit(0);
+}
+
+/**
+ * Listen on path and run driver once per request, each in a forked child.
+ * The targets are initialized before the first fork, so children start with
+ * the registry warm and only pay for the compilation itself. Forking also
+ * gives every request its own working directory, and concurrent requests
+ * can't see each other's state.
+ */
+int serve(const string &path, Driver driver)
+{
+	struct sockaddr_un address;
+	if (!setAddress(path, address)) {
+		fprintf(stderr, "socket path too long: %s\n", path.c_str());
+		return 1;
+	}
+
+	if (path.find('/') != string::npos && path.substr(0, path.find_last_of('/')) == getPrivateDirectory()
+	 && !makePrivate(getPrivateDirectory())) {
+		fprintf(stderr, "%s is not a directory private to this user\n", getPrivateDirectory().c_str());
+		return 1;
+	}
+
+	// only a socket left by an earlier server is replaced, never another file
+	struct stat info;
+	if (lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+		unlink(path.c_str());
+
+	int server = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (server < 0 || bind(server, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(server, 64) != 0) {
+		perror(path.c_str());
+		return 1;
+	}
+
+	initializeTargets();
+
+	// children are reaped by the kernel
+	signal(SIGCHLD, SIG_IGN);
+	fprintf(stderr, "listening on %s\n", path.c_str());
+
+	while (true) {
+		int connection = accept(server, NULL, NULL);
+		if (connection < 0)
+			continue;
+
+		pid_t child = fork();
+		if (child == 0) {
+			// the driver waits for the linker it runs, which SIG_IGN would reap
+			signal(SIGCHLD, SIG_DFL);
+			close(server);
+			handle(connection, driver);
+		}
+		close(connection);
+	}
+	return 0;
+}
+
+/**
+ * Send the arguments to the server at path. Returns false if there is no
+ * server or it isn't run by this user, status is the exit status of the
+ * compile otherwise.
+ */
+bool forward(const string &path, char **argv, int &status)
+{
+	struct sockaddr_un address;
+	if (!setAddress(path, address))
+		return false;
+
+	int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connection < 0)
+		return false;
+	if (connect(connection, (struct sockaddr*)&address, sizeof(address)) != 0) {
+		close(connection);
+		return false;
+	}
+
+	// the descriptors and environment are only handed to our own server
+	if (!isSameUser(connection)) {
+		fprintf(stderr, "%s: server runs as another user, compiling locally\n", path.c_str());
+		close(connection);
+		return false;
+	}
+
+	int fds[2] = { 1, 2 };
+	char control[CMSG_SPACE(sizeof(fds))];
+	memset(control, 0, sizeof(control));
+	char byte = 0;
+	struct iovec data = { &byte, 1 };
+	struct msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &data;
+	message.msg_iovlen = 1;
+	message.msg_control = control;
+	message.msg_controllen = sizeof(control);
+
+	struct cmsghdr *header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type = SCM_RIGHTS;
+	header->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+	char cwd[4096];
+	bool sent = sendmsg(connection, &message, MSG_NOSIGNAL) == 1 && getcwd(cwd, sizeof(cwd))
+	         && sendString(connection, cwd) && sendStrings(connection, argv) && sendStrings(connection, environ);
+
+	int32_t result;
+	bool received = sent && recvAll(connection, &result, sizeof(result));
+	close(connection);
+
+	// the request may have been handled partially, so don't retry locally
+	status = received ? result : 1;
+	return sent;
+}
+
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+
+namespace Cog
+{
+
+typedef int (*Driver)(int argc, char **argv);
+
+// $COG_SERVER, or cog.sock in $XDG_RUNTIME_DIR or a private /tmp/cog-UID
+std::string getSocketPath();
+
+int serve(const std::string &path, Driver driver);
+bool forward(const std::string &path, char **argv, int &status);
+
+}
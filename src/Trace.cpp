@@ -0,0 +1,153 @@
+#include "Trace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <sys/resource.h>
+
+using namespace std;
+
+namespace Cog
+{
+
+static const chrono::steady_clock::time_point origin = chrono::steady_clock::now();
+
+static string escape(const string &str)
+{
+	string result;
+	for (size_t i = 0; i < str.size(); i++) {
+		if (str[i] == '"' || str[i] == '\\')
+			result += '\\';
+		if ((unsigned char)str[i] < ' ')
+			continue;
+		result += str[i];
+	}
+	return result;
+}
+
+Trace::Trace()
+{
+	enabled = false;
+	tid = 0;
+}
+
+Trace::~Trace()
+{
+}
+
+int64_t Trace::now()
+{
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - origin).count();
+}
+
+void Trace::begin(const string &name, const string &detail)
+{
+	if (!enabled)
+		return;
+
+	Phase phase;
+	phase.name = name;
+	phase.detail = detail;
+	phase.start = now();
+	phases.push_back(phase);
+}
+
+/**
+ * Close the innermost phase and sample the peak RSS of the process.
+ */
+void Trace::end()
+{
+	if (!enabled || phases.empty())
+		return;
+
+	Phase &phase = phases.back();
+	int64_t finish = now();
+
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+
+	if (events.size() > 0)
+		events += ",\n";
+	events += "{\"name\":\"" + escape(phase.name) + "\",\"cat\":\"cog\",\"ph\":\"X\",\"pid\":1,\"tid\":" + to_string(tid) +
+		",\"ts\":" + to_string(phase.start) + ",\"dur\":" + to_string(finish - phase.start);
+	if (phase.detail != "")
+		events += ",\"args\":{\"detail\":\"" + escape(phase.detail) + "\"}";
+	events += "},\n{\"name\":\"peak RSS (KB)\",\"ph\":\"C\",\"pid\":1,\"tid\":" + to_string(tid) +
+		",\"ts\":" + to_string(finish) + ",\"args\":{\"KB\":" + to_string(usage.ru_maxrss) + "}}";
+
+	phases.pop_back();
+}
+
+void Trace::count(const string &name, int64_t delta)
+{
+	if (enabled)
+		counters[name] += delta;
+}
+
+/**
+ * Close whatever phases are still open and record the counters.
+ */
+void Trace::finish()
+{
+	if (!enabled)
+		return;
+
+	while (!phases.empty())
+		end();
+
+	if (counters.empty())
+		return;
+
+	if (events.size() > 0)
+		events += ",\n";
+	events += "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":" + to_string(tid) + ",\"ts\":" + to_string(now()) + ",\"args\":{";
+	for (auto counter = counters.begin(); counter != counters.end(); counter++) {
+		if (counter != counters.begin())
+			events += ",";
+		events += "\"" + escape(counter->first) + "\":" + to_string(counter->second);
+	}
+	events += "}}";
+}
+
+bool Trace::write(const string &filename, const vector<string> &events)
+{
+	FILE *file = fopen(filename.c_str(), "w");
+	if (!file)
+		return false;
+
+	fputs("{\"traceEvents\":[\n", file);
+	bool first = true;
+	for (auto event = events.begin(); event != events.end(); event++) {
+		if (event->empty())
+			continue;
+		if (!first)
+			fputs(",\n", file);
+		fputs(event->c_str(), file);
+		first = false;
+	}
+	fputs("\n]}\n", file);
+	return fclose(file) == 0;
+}
+
+TraceScope::TraceScope(Trace &trace, const string &name, const string &detail) : trace(trace)
+{
+	trace.begin(name, detail);
+}
+
+TraceScope::~TraceScope()
+{
+	trace.end();
+}
+
+TraceTotal::TraceTotal(Trace &trace, const char *name) : trace(trace)
+{
+	this->name = name;
+	start = trace.enabled ? Trace::now() : 0;
+}
+
+TraceTotal::~TraceTotal()
+{
+	if (trace.enabled)
+		trace.count(name, Trace::now() - start);
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdint>
+
+namespace Cog
+{
+
+/**
+ * Collects the events of one compilation in the Chrome trace event format,
+ * see chrome://tracing or ui.perfetto.dev. Phases nest, and short phases
+ * that happen too often to be worth an event each are summed up instead.
+ * Nothing is recorded unless enabled is set.
+ */
+struct Trace
+{
+	Trace();
+	~Trace();
+
+	struct Phase
+	{
+		std::string name;
+		std::string detail;
+		int64_t start;
+	};
+
+	bool enabled;
+	int tid;
+
+	// comma separated events, ready to go into a traceEvents array
+	std::string events;
+	std::vector<Phase> phases;
+	std::map<std::string, int64_t> counters;
+
+	void begin(const std::string &name, const std::string &detail = "");
+	void end();
+	void count(const std::string &name, int64_t delta = 1);
+	void finish();
+
+	// microseconds since the process started tracing
+	static int64_t now();
+	static bool write(const std::string &filename, const std::vector<std::string> &events);
+};
+
+struct TraceScope
+{
+	TraceScope(Trace &trace, const std::string &name, const std::string &detail = "");
+	~TraceScope();
+
+	Trace &trace;
+};
+
+/**
+ * Adds the time it lives to the counter name, in microseconds.
+ */
+struct TraceTotal
+{
+	TraceTotal(Trace &trace, const char *name);
+	~TraceTotal();
+
+	Trace &trace;
+	const char *name;
+	int64_t start;
+};
+
+}
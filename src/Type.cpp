@@ -8,14 +8,20 @@
 #include <llvm/IR/Constants.h>
 
 #include <sstream>
-
-extern Cog::Compiler cog;
+#include <functional>
 
 namespace Cog
 {
 
+static size_t hashCombine(size_t seed, size_t value)
+{
+	return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
 Type::Type()
 {
+	kind = id;
+	hashValue = 0;
 	llvmType = NULL;
 }
 
@@ -28,6 +34,21 @@ llvm::Value *Type::undefValue() const
 	return llvm::UndefValue::get(llvmType);
 }
 
+size_t TypeHash::operator()(const Type *type) const
+{
+	return type->hashValue;
+}
+
+bool TypeEqual::operator()(const Type *left, const Type *right) const
+{
+	return left == right || (left->hashValue == right->hashValue && left->eq((Type*)right));
+}
+
+size_t TypePairHash::operator()(const std::pair<Type*, Type*> &types) const
+{
+	return hashCombine(types.first->hashValue, types.second->hashValue);
+}
+
 Declaration::Declaration()
 {
 }
@@ -42,8 +63,9 @@ Declaration::~Declaration()
 {
 }
 
-Void::Void()
+Void::Void(Compiler &cog)
 {
+	kind = id;
 	llvmType = llvm::Type::getVoidTy(cog.context);
 }
 
@@ -58,11 +80,17 @@ std::string Void::name() const
 
 bool Void::eq(Type *other) const
 {
-	return other->id == id;
+	return other->kind == id;
+}
+
+size_t Void::hash() const
+{
+	return std::hash<int>()(id);
 }
 
-Boolean::Boolean()
+Boolean::Boolean(Compiler &cog)
 {
+	kind = id;
 	llvmType = llvm::Type::getInt1Ty(cog.context);
 }
 
@@ -77,11 +105,17 @@ std::string Boolean::name() const
 
 bool Boolean::eq(Type *other) const
 {
-	return other->id == id;
+	return other->kind == id;
 }
 
-Fixed::Fixed(bool isSigned, int bitwidth, int exponent)
+size_t Boolean::hash() const
 {
+	return std::hash<int>()(id);
+}
+
+Fixed::Fixed(Compiler &cog, bool isSigned, int bitwidth, int exponent)
+{
+	kind = id;
 	this->isSigned = isSigned;
 	this->bitwidth = bitwidth;
 	this->exponent = exponent;
@@ -108,7 +142,7 @@ std::string Fixed::name() const
 
 bool Fixed::eq(Type *other) const
 {
-	if (other->id != id)
+	if (other->kind != id)
 		return false;
 
 	const Fixed *otherFixed = other->get(this);
@@ -117,8 +151,18 @@ bool Fixed::eq(Type *other) const
 	    && otherFixed->isSigned == isSigned;
 }
 
-Float::Float(int bitwidth)
+size_t Fixed::hash() const
 {
+	size_t result = std::hash<int>()(id);
+	result = hashCombine(result, std::hash<bool>()(isSigned));
+	result = hashCombine(result, std::hash<int>()(bitwidth));
+	result = hashCombine(result, std::hash<int>()(exponent));
+	return result;
+}
+
+Float::Float(Compiler &cog, int bitwidth)
+{
+	kind = id;
 	this->bitwidth = bitwidth;
 	switch (bitwidth) {
 	case 16:
@@ -174,15 +218,21 @@ std::string Float::name() const
 
 bool Float::eq(Type *other) const
 {
-	if (other->id != id)
+	if (other->kind != id)
 		return false;
 
 	const Float *otherFloat = other->get(this);
 	return otherFloat->bitwidth == bitwidth;
 }
 
+size_t Float::hash() const
+{
+	return hashCombine(std::hash<int>()(id), std::hash<int>()(bitwidth));
+}
+
 StaticArray::StaticArray()
 {
+	kind = id;
 	this->llvmType = NULL;
 	this->arrType = NULL;
 	this->size = -1;
@@ -190,6 +240,7 @@ StaticArray::StaticArray()
 
 StaticArray::StaticArray(Type *arrType, int size)
 {
+	kind = id;
 	this->arrType = arrType;
 	this->size = size;
 	this->llvmType = llvm::ArrayType::get(arrType->llvmType, size);
@@ -211,24 +262,32 @@ std::string StaticArray::name() const
 
 bool StaticArray::eq(Type *other) const
 {
-	if (other->id != id)
+	if (other->kind != id)
 		return false;
 
 	const StaticArray *otherArray = other->get(this);
-	if (otherArray->size != size)
-		return false;
+	return otherArray->size == size
+	    && otherArray->arrType == arrType;
+}
 
-	return arrType->eq(otherArray->arrType);
+size_t StaticArray::hash() const
+{
+	size_t result = std::hash<int>()(id);
+	result = hashCombine(result, std::hash<const Type*>()(arrType));
+	result = hashCombine(result, std::hash<int>()(size));
+	return result;
 }
 
 Pointer::Pointer()
 {
+	kind = id;
 	this->ptrType = NULL;
 	this->llvmType = NULL;
 }
 
 Pointer::Pointer(Type *ptrType)
 {
+	kind = id;
 	this->ptrType = ptrType;
 	this->llvmType = llvm::PointerType::get(ptrType->llvmType, 0);
 }
@@ -249,26 +308,34 @@ std::string Pointer::name() const
 
 bool Pointer::eq(Type *other) const
 {
-	if (other->id != id)
+	if (other->kind != id)
 		return false;
 
 	const Pointer *otherPointer = other->get(this);
-	return ptrType->eq(otherPointer->ptrType);
+	return otherPointer->ptrType == ptrType;
+}
+
+size_t Pointer::hash() const
+{
+	return hashCombine(std::hash<int>()(id), std::hash<const Type*>()(ptrType));
 }
 
 Struct::Struct()
 {
+	kind = id;
 	this->llvmType = NULL;
 }
 
-Struct::Struct(std::string typeName)
+Struct::Struct(Compiler &cog, std::string typeName)
 {
+	kind = id;
 	this->typeName = typeName;
 	this->llvmType = llvm::StructType::create(cog.context, typeName);
 }
 
-Struct::Struct(std::string typeName, std::vector<Declaration> members)
+Struct::Struct(Compiler &cog, std::string typeName, std::vector<Declaration> members)
 {
+	kind = id;
 	std::vector<llvm::Type*> memberTypes;
 	for (int i = 0; i < (int)members.size(); i++) {
 		memberTypes.push_back(members[i].type->llvmType);
@@ -290,20 +357,27 @@ std::string Struct::name() const
 
 bool Struct::eq(Type *other) const
 {
-	if (other->id != id)
+	if (other->kind != id)
 		return false;
 
 	const Struct *otherStruct = other->get(this);
 	return otherStruct->typeName == typeName;
 }
 
+size_t Struct::hash() const
+{
+	return hashCombine(std::hash<int>()(id), std::hash<std::string>()(typeName));
+}
+
 Tuple::Tuple()
 {
+	kind = id;
 	this->llvmType = NULL;
 }
 
-Tuple::Tuple(std::vector<Declaration> members)
+Tuple::Tuple(Compiler &cog, std::vector<Declaration> members)
 {
+	kind = id;
 	std::vector<llvm::Type*> memberTypes;
 	for (int i = 0; i < (int)members.size(); i++) {
 		memberTypes.push_back(members[i].type->llvmType);
@@ -336,7 +410,7 @@ std::string Tuple::name() const
 
 bool Tuple::eq(Type *other) const
 {
-	if (other->id != id)
+	if (other->kind != id)
 		return false;
 
 	const Tuple *otherTuple = other->get(this);
@@ -344,15 +418,24 @@ bool Tuple::eq(Type *other) const
 		return false;
 
 	for (int i = 0; i < (int)members.size(); i++) {
-		if (!members[i].type->eq(otherTuple->members[i].type))
+		if (members[i].type != otherTuple->members[i].type)
 			return false;
 	}
 
 	return true;
 }
 
+size_t Tuple::hash() const
+{
+	size_t result = std::hash<int>()(id);
+	for (int i = 0; i < (int)members.size(); i++)
+		result = hashCombine(result, std::hash<const Type*>()(members[i].type));
+	return result;
+}
+
 Function::Function()
 {
+	kind = id;
 	llvmType = NULL;
 	retType = NULL;
 	thisType = NULL;
@@ -360,8 +443,9 @@ Function::Function()
 
 Function::Function(Type *retType, Type *thisType, std::string typeName, std::vector<Declaration> args)
 {
+	kind = id;
 	std::vector<llvm::Type*> argTypes;
-	if (thisType != NULL)
+	if (thisType != NULL && !thisType->is<Void>())
 		argTypes.push_back(thisType->llvmType);
 
 	for (int i = 0; i < (int)args.size(); i++) {
@@ -395,26 +479,35 @@ std::string Function::name() const
 
 bool Function::eq(Type *other) const
 {
-	if (other->id != id)
-		return false;
-
-	Function *otherFunc = other->get(this);
-	if ((thisType == NULL) != (otherFunc->thisType == NULL))
+	if (other->kind != id)
 		return false;
 
-	if (thisType != NULL && !thisType->eq(otherFunc->thisType))
+	const Function *otherFunc = other->get(this);
+	if (otherFunc->typeName != typeName
+	 || otherFunc->retType != retType
+	 || otherFunc->thisType != thisType)
 		return false;
 
 	if (args.size() != otherFunc->args.size())
 		return false;
 
 	for (int i = 0; i < (int)args.size(); i++) {
-		if (!args[i].type->eq(otherFunc->args[i].type))
+		if (args[i].type != otherFunc->args[i].type)
 			return false;
 	}
 
 	return true;
 }
 
+size_t Function::hash() const
+{
+	size_t result = std::hash<int>()(id);
+	result = hashCombine(result, std::hash<std::string>()(typeName));
+	result = hashCombine(result, std::hash<const Type*>()(retType));
+	result = hashCombine(result, std::hash<const Type*>()(thisType));
+	for (int i = 0; i < (int)args.size(); i++)
+		result = hashCombine(result, std::hash<const Type*>()(args[i].type));
+	return result;
 }
 
+}
@@ -8,10 +8,13 @@
 #include <vector>
 #include <list>
 #include <string>
+#include <utility>
 
 namespace Cog
 {
 
+struct Compiler;
+
 struct Type
 {
 	static const int id = __COUNTER__;
@@ -19,6 +22,8 @@ struct Type
 	Type();
 	virtual ~Type();
 
+	int kind;
+	size_t hashValue;
 	llvm::Type *llvmType;
 
 	template <typename ToType>
@@ -36,20 +41,38 @@ struct Type
 	template <typename cmpType>
 	bool is()
 	{
-		return id == cmpType::id;
+		return kind == cmpType::id;
 	}
 
 	template <typename cmpType>
 	bool is() const
 	{
-		return id == cmpType::id;
+		return kind == cmpType::id;
 	}
 
 	virtual std::string name() const = 0;
 	virtual bool eq(Type *other) const = 0;
+	virtual size_t hash() const = 0;
 	llvm::Value *undefValue() const;
 };
 
+// Types are hash-consed by Compiler::getType, so these only ever see the
+// cached hashValue and compare the direct children of two nodes by pointer.
+struct TypeHash
+{
+	size_t operator()(const Type *type) const;
+};
+
+struct TypeEqual
+{
+	bool operator()(const Type *left, const Type *right) const;
+};
+
+struct TypePairHash
+{
+	size_t operator()(const std::pair<Type*, Type*> &types) const;
+};
+
 struct Declaration
 {
 	static const int id = __COUNTER__;
@@ -90,29 +113,31 @@ struct Void : Type
 {
 	static const int id = __COUNTER__;
 	
-	Void();
+	Void(Compiler &cog);
 	~Void();
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 struct Boolean : Type
 {
 	static const int id = __COUNTER__;
 	
-	Boolean();
+	Boolean(Compiler &cog);
 	~Boolean();
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 struct Fixed : Type
 {
 	static const int id = __COUNTER__;
 	
-	Fixed(bool isSigned, int bitwidth, int exponent = 0);
+	Fixed(Compiler &cog, bool isSigned, int bitwidth, int exponent = 0);
 	~Fixed();
 
 	bool isSigned;
@@ -121,13 +146,14 @@ struct Fixed : Type
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 struct Float : Type
 {
 	static const int id = __COUNTER__;
 	
-	Float(int bitwidth);
+	Float(Compiler &cog, int bitwidth);
 	~Float();
 
 	int bitwidth;
@@ -137,6 +163,7 @@ struct Float : Type
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 struct StaticArray : Type
@@ -152,6 +179,7 @@ struct StaticArray : Type
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 struct Pointer : Type
@@ -166,6 +194,7 @@ struct Pointer : Type
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 struct Struct : Type
@@ -173,8 +202,8 @@ struct Struct : Type
 	static const int id = __COUNTER__;
 	
 	Struct();
-	Struct(std::string typeName);
-	Struct(std::string typeName, std::vector<Declaration> members);
+	Struct(Compiler &cog, std::string typeName);
+	Struct(Compiler &cog, std::string typeName, std::vector<Declaration> members);
 	~Struct();
 
 	std::string typeName;
@@ -182,6 +211,7 @@ struct Struct : Type
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 struct Tuple : Type
@@ -189,13 +219,14 @@ struct Tuple : Type
 	static const int id = __COUNTER__;
 	
 	Tuple();
-	Tuple(std::vector<Declaration> members);
+	Tuple(Compiler &cog, std::vector<Declaration> members);
 	~Tuple();
 
 	std::vector<Declaration> members;
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 struct Function : Type
@@ -213,6 +244,7 @@ struct Function : Type
 
 	std::string name() const;
 	bool eq(Type *other) const;
+	size_t hash() const;
 };
 
 }
@@ -23,58 +23,37 @@ Instance::~Instance()
 Symbol::Symbol(Type *type, std::string name) : Declaration(type, name)
 {
 	ref = NULL;
-
-	values.push_back(type->undefValue());
-	values.back().setName(name);
-	curr = values.begin();
+	key = NULL;
+	scope = NULL;
+	shadow = NULL;
+	value = type->undefValue();
 }
 
-Symbol(const Declaration &decl) : Declaration(decl)
+Symbol::Symbol(const Declaration &decl) : Declaration(decl)
 {
 	ref = NULL;
-
-	values.push_back(type->undefValue());
-	values.back().setName(name);
-	curr = values.begin();
-}
-
-Symbol(const Instance &inst) : Declaration(inst)
-{
-	this->ref = inst.ref;
-	this->values.push_back(inst.value);
-	this->curr = values.begin();
+	key = NULL;
+	scope = NULL;
+	shadow = NULL;
+	value = type->undefValue();
 }
 
-Symbol::Symbol(const Symbol &copy) : Declaration(copy)
+Symbol::Symbol(const Instance &inst) : Declaration(inst)
 {
-	this->ref = copy.ref;
-	this->values = copy.values;
-	for (curr = values.begin(); curr != values.end() && *curr != *copy.curr; ++curr);
+	ref = inst.ref;
+	key = NULL;
+	scope = NULL;
+	shadow = NULL;
+	value = inst.value;
 }
 
 Symbol::~Symbol()
 {
 }
 
-void Symbol::nextValue()
-{
-	++curr;
-}
-
-void Symbol::popValue()
-{
-	values.erase(curr++);
-}
-
-void Symbol::setValue(llvm::Value *value)
-{
-	*curr = value;
-}
-
 llvm::Value *Symbol::getValue()
 {
-	return *curr;
+	return value;
 }
 
 }
-
@@ -12,6 +12,8 @@
 namespace Cog
 {
 
+struct Scope;
+
 struct Instance : Declaration
 {
 	static const int id = __COUNTER__;
@@ -36,12 +38,17 @@ struct Symbol : Declaration
 
 	Instance *ref;
 
-	std::list<llvm::Value*> values;
-	std::list<llvm::Value*>::iterator curr;
+	// interned name, the key of this symbol in Compiler::symbols
+	const char *key;
+	// the scope that declared this symbol
+	Scope *scope;
+	// the symbol with the same name that this one hides until its scope is popped
+	Symbol *shadow;
+
+	// the value bound to this symbol in the block currently being generated,
+	// use Scope::setValue to rebind it.
+	llvm::Value *value;
 
-	void nextValue();
-	void popValue();
-	void setValue(llvm::Value *value);
 	llvm::Value *getValue();
 };
 
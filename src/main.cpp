@@ -1,22 +1,66 @@
 #include "Compiler.h"
 #include "Parser.y.h"
+#include "Server.h"
+#include "Build.h"
+#include "Lsp.h"
 
 #include <vector>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <string.h>
+#include <stdlib.h>
+#include <cinttypes>
+#include <memory>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
 using std::vector;
 
-Cog::Compiler cog;
-extern FILE* yyin;
-
-int main(int argc, char **argv)
+/**
+ * Lex filename through stdio and then through the memory mapped buffer,
+ * reporting the throughput of each.
+ */
+int benchLexer(const char *filename)
 {
-	if (argc != 2)
-		return 1;
+	for (int mapped = 0; mapped < 2; mapped++) {
+		Cog::Compiler cog;
+		auto start = std::chrono::steady_clock::now();
+
+		if (!Cog::openSource(cog, filename, mapped)) {
+			fprintf(stderr, "unable to open '%s'\n", filename);
+			return 1;
+		}
+
+		YYSTYPE value;
+		long tokens = 0;
+		while (yylex(&value, cog.scanner) != 0)
+			++tokens;
 
-	cog.loadFile(argv[1]);
+		Cog::closeSource(cog);
 
-	yyin = fopen(argv[1], "r");
-	yyparse();
-	fclose(yyin);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("%s: %ld tokens in %.3fs, %.0f tokens/s\n", mapped ? "mmap" : "stdio", tokens, seconds, tokens/seconds);
+	}
+
+	return 0;
+}
+
+/**
+ * Compile filename with cog, which is used for nothing else. Only an entry,
+ * see Options::entry, gets a _start that calls its main.
+ */
+bool build(Cog::Compiler &cog, const char *filename)
+{
+	Cog::TraceScope phase(cog.trace, "Compile", filename);
+	cog.loadFile(filename);
+	if (cog.fetchCached())
+		return true;
+	if (!cog.parse())
+		return false;
+	if (!cog.options.entry)
+		return cog.emit();
 
 	/* Create the top level interpreter function to call as entry */
 	vector<Type*> argTypes;
@@ -25,17 +69,349 @@ int main(int argc, char **argv)
 	BasicBlock *_startBody = BasicBlock::Create(cog.context, "entry", _start, 0);
 	cog.getScope()->setBlock(_startBody);
 	cog.builder.SetInsertPoint(_startBody);
-	
-	for (auto type = cog.types.begin(); type != cog.types.end(); type++)
-		printf("%s\n", type->getName().c_str());
 
 	vector<Value*> argValues;
 	cog.builder.CreateCall(cog.module->getFunction("(void)main"), argValues);
 	cog.createExit();
 
+	return cog.emit();
+}
+
+/**
+ * Run the whole pipeline for a single source file. Each call owns its own
+ * Compiler, and with it its own LLVMContext and Module, so calls may run on
+ * separate threads. Everything the compilation reports is returned in log,
+ * and its trace events, if options.timeTrace is set, in trace.
+ */
+bool compile(const char *filename, const Cog::Options &options, int index, std::string &log, std::string &trace)
+{
+	Cog::Compiler cog(options);
+	cog.trace.tid = index + 1;
+	bool result = build(cog, filename);
+	cog.finishTrace();
+
+	log = cog.log.str();
+	trace = cog.trace.events;
+	return result;
+}
+
+/**
+ * One file of cog build, see Cog::build.
+ */
+bool buildFile(const char *filename, const Cog::Options &options, std::string &log)
+{
+	Cog::Compiler cog(options);
+	bool result = build(cog, filename);
+	log = cog.log.str();
+	return result;
+}
+
+/**
+ * Parse a comma separated list of obj, asm, bc and ll into a mask of
+ * Cog::Output, 0 if any of them is unknown.
+ */
+int parseOutputs(const char *list)
+{
+	int outputs = 0;
+	while (*list) {
+		size_t length = strcspn(list, ",");
+		if (length == 3 && strncmp(list, "obj", 3) == 0)
+			outputs |= Cog::OBJECT_OUTPUT;
+		else if (length == 3 && strncmp(list, "asm", 3) == 0)
+			outputs |= Cog::ASSEMBLY_OUTPUT;
+		else if (length == 2 && strncmp(list, "bc", 2) == 0)
+			outputs |= Cog::BITCODE_OUTPUT;
+		else if (length == 2 && strncmp(list, "ll", 2) == 0)
+			outputs |= Cog::IR_OUTPUT;
+		else
+			return 0;
+
+		list += length;
+		if (*list == ',')
+			list++;
+	}
+	return outputs;
+}
+
+/**
+ * Compile filename into memory and call its main. The compiler's messages go
+ * to stderr so that stdout only has the program's output.
+ */
+int run(const char *filename, const Cog::Options &options)
+{
+	Cog::Compiler cog(options);
+	cog.loadFile(filename);
+	void (*entry)() = cog.jit();
+	fputs(cog.log.str().c_str(), stderr);
+	if (!entry)
+		return 1;
+
+	// the program may exit without returning here
+	if (options.cache)
+		options.cache->flush();
+	fflush(stderr);
+	entry();
+	return 0;
+}
+
+typedef std::chrono::system_clock Clock;
+
+// as early as static initialization of this file gets
+static const Clock::time_point processStart = Clock::now();
+
+static double msSince(Clock::time_point start, Clock::time_point end)
+{
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/**
+ * Time the work every compile does before it reads its source. Process start
+ * is measured from $COG_EXEC_TIME, in nanoseconds since the epoch, when
+ * --bench-startup passes it, and otherwise only from static initialization.
+ */
+int timeStartup()
+{
+	Clock::time_point mainStart = Clock::now();
+	Clock::time_point execTime = processStart;
+	const char *exec = getenv("COG_EXEC_TIME");
+	if (exec)
+		execTime = Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(atoll(exec))));
+
+	Clock::time_point llvmStart = Clock::now();
+	Cog::initializeTargets();
+	Cog::Compiler cog;
+	cog.loadFile("startup");
 	cog.setTarget();
-	//cog.emit(TargetMachine::CGFT_AssemblyFile);
-	cog.emit();
+	Clock::time_point llvmEnd = Clock::now();
+
+	Cog::Compiler parser;
+	Cog::openSource(parser, "/dev/null", false);
+	Cog::closeSource(parser);
+	Clock::time_point parserEnd = Clock::now();
+
+	fprintf(stderr, "process start: %8.3f ms%s\n", msSince(execTime, mainStart), exec ? "" : " (from static initialization)");
+	fprintf(stderr, "llvm init:     %8.3f ms\n", msSince(llvmStart, llvmEnd));
+	fprintf(stderr, "parser setup:  %8.3f ms\n", msSince(llvmEnd, parserEnd));
+	fprintf(stderr, "total:         %8.3f ms\n", msSince(execTime, parserEnd));
+	return 0;
+}
+
+/**
+ * Run cog --time-startup count times from fork to exit and check the median
+ * against the budget for a cold start.
+ */
+int benchStartup(const char *self, int count)
+{
+	const double budget = 10.0;
+	if (count < 1)
+		count = 1;
+
+	vector<double> times;
+	for (int i = 0; i < count; i++) {
+		Clock::time_point start = Clock::now();
+		pid_t child = fork();
+		if (child == 0) {
+			std::string now = std::to_string(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count());
+			setenv("COG_EXEC_TIME", now.c_str(), 1);
+			// only the last run shows its breakdown
+			if (i+1 < count)
+				freopen("/dev/null", "w", stderr);
+			execl(self, self, "--time-startup", (char*)NULL);
+			_exit(127);
+		}
+
+		int status;
+		if (child < 0 || waitpid(child, &status, 0) != child || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			fprintf(stderr, "could not run %s --time-startup\n", self);
+			return 1;
+		}
+		times.push_back(msSince(start, Clock::now()));
+	}
+
+	std::sort(times.begin(), times.end());
+	double median = times[times.size()/2];
+	printf("startup: min %.3f ms, median %.3f ms, max %.3f ms over %d runs, budget %.1f ms\n",
+		times.front(), median, times.back(), count, budget);
+	return median <= budget ? 0 : 1;
+}
+
+/**
+ * Everything but the server, either run directly or by the server for one of
+ * its clients.
+ */
+int driver(int argc, char **argv)
+{
+	if (argc == 3 && strcmp(argv[1], "--bench-lexer") == 0)
+		return benchLexer(argv[2]);
+	if (argc == 2 && strcmp(argv[1], "--time-startup") == 0)
+		return timeStartup();
+	if (argc >= 2 && strcmp(argv[1], "--bench-startup") == 0)
+		return benchStartup("/proc/self/exe", argc > 2 ? atoi(argv[2]) : 100);
+
+	int jobs = 1;
+	Cog::Options options;
+	vector<const char*> inputs;
+	const char *cacheDir = getenv("COG_CACHE");
+	long cacheSize = 1024;
+	bool cacheStats = false;
+	bool emitSeen = false;
+	const char *runFile = NULL;
+	bool buildMode = false;
+	const char *traceFile = NULL;
+	for (int i = 1; i < argc; i++) {
+		// main takes no arguments yet, so nothing may follow the file
+		if (strcmp(argv[i], "run") == 0 && inputs.size() == 0 && i+1 < argc) {
+			if (i+2 < argc) {
+				fprintf(stderr, "main takes no arguments yet\n");
+				fprintf(stderr, "usage: %s [options] run file.cog\n", argv[0]);
+				return 1;
+			}
+			runFile = argv[i+1];
+			break;
+		} else if (strcmp(argv[i], "build") == 0 && inputs.size() == 0 && !buildMode)
+			buildMode = true;
+		else if (strcmp(argv[i], "-j") == 0 && i+1 < argc)
+			jobs = atoi(argv[++i]);
+		else if (strncmp(argv[i], "-j", 2) == 0)
+			jobs = atoi(argv[i]+2);
+		else if (strcmp(argv[i], "--partitions") == 0 && i+1 < argc)
+			options.partitions = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--codegen-threads") == 0 && i+1 < argc)
+			options.codegenThreads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--ir-threads") == 0 && i+1 < argc)
+			options.irThreads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-Os") == 0)
+			options.optLevel = 2, options.sizeLevel = 1;
+		else if (strcmp(argv[i], "-Oz") == 0)
+			options.optLevel = 2, options.sizeLevel = 2;
+		else if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '3' && argv[i][3] == 0)
+			options.optLevel = argv[i][2] - '0', options.sizeLevel = 0;
+		else if (strncmp(argv[i], "--emit=", 7) == 0) {
+			int outputs = parseOutputs(argv[i]+7);
+			if (outputs == 0) {
+				fprintf(stderr, "unknown output in '%s', expected obj, asm, bc or ll\n", argv[i]);
+				return 1;
+			}
+			options.outputs = emitSeen ? options.outputs | outputs : outputs;
+			emitSeen = true;
+		} else if (strncmp(argv[i], "--time-trace=", 13) == 0) {
+			traceFile = argv[i]+13;
+			options.timeTrace = true;
+		} else if (strcmp(argv[i], "--dump-ir") == 0)
+			options.dumpIR = true;
+		else if (strcmp(argv[i], "--split-objects") == 0)
+			options.splitObjects = true;
+		else if (strcmp(argv[i], "--stream") == 0)
+			options.stream = true;
+		else if (strcmp(argv[i], "--cache") == 0 && i+1 < argc)
+			cacheDir = argv[++i];
+		else if (strcmp(argv[i], "--cache-size") == 0 && i+1 < argc)
+			cacheSize = atol(argv[++i]);
+		else if (strcmp(argv[i], "--cache-stats") == 0)
+			cacheStats = true;
+		else
+			inputs.push_back(argv[i]);
+	}
+
+	std::unique_ptr<Cog::Cache> cache;
+	if (cacheDir && cacheDir[0]) {
+		cache.reset(new Cog::Cache(cacheDir, (uint64_t)cacheSize << 20));
+		options.cache = cache.get();
+	} else if (runFile && getenv("HOME")) {
+		std::string home = getenv("HOME");
+		mkdir((home + "/.cache").c_str(), 0755);
+		cache.reset(new Cog::Cache(home + "/.cache/cog", (uint64_t)cacheSize << 20));
+		options.cache = cache.get();
+	}
+
+	if (cacheStats) {
+		uint64_t hits, misses, entries, size;
+		if (!cache || !cache->readStats(hits, misses, entries, size)) {
+			fprintf(stderr, "no cache directory, use --cache DIR or COG_CACHE\n");
+			return 1;
+		}
+		printf("%" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " entries, %" PRIu64 " bytes\n", hits, misses, entries, size);
+		return 0;
+	}
+
+	// the JIT needs the whole module at once
+	options.stream = options.stream && !runFile;
+	if (options.stream && options.outputs != Cog::OBJECT_OUTPUT) {
+		fprintf(stderr, "--stream only writes objects, use --emit=obj\n");
+		return 1;
+	}
+
+	if (runFile)
+		return run(runFile, options);
+
+	if (inputs.size() == 0) {
+		fprintf(stderr, "usage: %s [options] run file.cog\n", argv[0]);
+		fprintf(stderr, "usage: %s [options] build file.cog...\n", argv[0]);
+		fprintf(stderr, "usage: %s lsp\n", argv[0]);
+		fprintf(stderr, "usage: %s [-j N] [-O0|-O1|-O2|-O3|-Os|-Oz] [--emit=obj,asm,bc,ll] [--dump-ir] [--time-trace=out.json] [--partitions N] [--codegen-threads N] [--split-objects] [--stream] [--cache DIR] [--cache-size MB] [--cache-stats] file.cog...\n", argv[0]);
+		return 1;
+	}
+
+	if (options.partitions < 1)
+		options.partitions = 1;
+
+	if (jobs < 1)
+		jobs = 1;
+	if (buildMode)
+		return Cog::build(vector<std::string>(inputs.begin(), inputs.end()), options, jobs, buildFile);
+	if (jobs > (int)inputs.size())
+		jobs = inputs.size();
+
+	// workers take the next file off a shared counter, results are kept per
+	// input so the output doesn't depend on the scheduling
+	vector<std::string> logs(inputs.size());
+	vector<std::string> traces(inputs.size());
+	vector<char> results(inputs.size(), 0);
+	std::atomic<size_t> next(0);
+	auto worker = [&]() {
+		for (size_t i = next++; i < inputs.size(); i = next++)
+			results[i] = compile(inputs[i], options, i, logs[i], traces[i]);
+	};
+
+	vector<std::thread> threads;
+	for (int i = 1; i < jobs; i++)
+		threads.emplace_back(worker);
+	worker();
+	for (auto thread = threads.begin(); thread != threads.end(); thread++)
+		thread->join();
+
+	int status = 0;
+	for (size_t i = 0; i < inputs.size(); i++) {
+		fputs(logs[i].c_str(), stdout);
+		if (!results[i]) {
+			fprintf(stderr, "%s: compilation failed\n", inputs[i]);
+			status = 1;
+		}
+	}
+
+	if (cache)
+		printf("cache: %d hits, %d misses\n", (int)cache->hits, (int)cache->misses);
+
+	if (traceFile && !Cog::Trace::write(traceFile, traces)) {
+		fprintf(stderr, "could not write '%s'\n", traceFile);
+		status = 1;
+	}
 	
-  return 0;
+	return status;
+}
+
+int main(int argc, char **argv)
+{
+	if (argc >= 2 && strcmp(argv[1], "--server") == 0)
+		return Cog::serve(argc > 2 ? argv[2] : Cog::getSocketPath(), driver);
+	// talks over stdin, which a server can't be handed
+	if (argc == 2 && strcmp(argv[1], "lsp") == 0)
+		return Cog::serveLsp();
+
+	// hand the work to a running server when COG_SERVER points at one
+	int status;
+	if (getenv("COG_SERVER") && Cog::forward(Cog::getSocketPath(), argv, status))
+		return status;
+
+	return driver(argc, argv);
 }
@@ -0,0 +1,74 @@
+#include "Compiler.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <csignal>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace Cog;
+
+/**
+ * JIT source and run its main in a child, which fails the test if it doesn't
+ * return within a few seconds. A loop that never sees its back edge values
+ * spins forever.
+ */
+static void expectReturns(const std::string &source)
+{
+	char path[] = "/tmp/cog-test-XXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_GE(fd, 0);
+	ASSERT_EQ(write(fd, source.data(), source.size()), (ssize_t)source.size());
+	close(fd);
+
+	initializeTargets();
+	Compiler cog;
+	cog.loadFile(path);
+	void (*entry)() = cog.jit();
+	unlink(path);
+	ASSERT_TRUE(entry != NULL) << cog.log.str();
+	EXPECT_TRUE(cog.diagnostics.empty()) << cog.log.str();
+
+	pid_t pid = fork();
+	ASSERT_GE(pid, 0);
+	if (pid == 0) {
+		alarm(5);
+		entry();
+		_exit(0);
+	}
+
+	int status;
+	ASSERT_EQ(waitpid(pid, &status, 0), pid);
+	EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << "main did not return";
+}
+
+TEST(Loops, Single)
+{
+	expectReturns(
+		"void main()\n"
+		"{\n"
+		"	int32 i = 0;\n"
+		"	while (i < 4) {\n"
+		"		i = i + 1;\n"
+		"	}\n"
+		"}\n");
+}
+
+// j is declared in the outer body, so only the inner loop needs a PHI for it
+TEST(Loops, InnerUpdatesOuterBodyLocal)
+{
+	expectReturns(
+		"void main()\n"
+		"{\n"
+		"	int32 i = 0;\n"
+		"	while (i < 4) {\n"
+		"		int32 j = 0;\n"
+		"		while (j < 3) {\n"
+		"			j = j + 1;\n"
+		"		}\n"
+		"		i = i + 1;\n"
+		"	}\n"
+		"}\n");
+}